@@ -27,46 +27,548 @@
 //   Description:
 //     Running Applications on Memory Container
 //
+//     Latency and throughput harness. Workers (processes, each with
+//     a number of threads) lock, map, first-touch and unlock every
+//     object of their container and time each step separately. The
+//     result is printed as CSV or JSON with p50/p99/p999 latencies
+//     and operations per second.
+//
+//     Called with the four positional arguments of the original
+//     benchmark and no options, it runs that workload instead and
+//     writes binary mcontainer.<pid>.log files for validate, or text
+//     logs with -P legacy -L text.
+//
 ////////////////////////////////////////////////////////////////////////
 
 #include <mcontainer.h>
+#include "mcontainer_log.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <getopt.h>
+#include <pthread.h>
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/syscall.h>
 
-float _get_uptime() {
-    float uptime;
-    FILE* proc_uptime_file = fopen("/proc/uptime", "r");
-    fscanf(proc_uptime_file, "%f", &uptime);
-    return uptime;
+// steps timed for every object
+enum
+{
+    STEP_LOCK,
+    STEP_ALLOC,
+    STEP_TOUCH,
+    STEP_UNLOCK,
+    STEP_TOTAL,
+    NUMBER_OF_STEPS
+};
+
+static const char *step_names[NUMBER_OF_STEPS] = {"lock", "alloc", "touch", "unlock", "total"};
+
+enum
+{
+    LOCK_IOCTL,
+    LOCK_FAST,
+    LOCK_NONE,
+    LOCK_SHARED
+};
+
+static const char *lock_mode_names[] = {"ioctl", "fast", "none", "shared"};
+
+struct config
+{
+    int number_of_objects;
+    int max_size_of_objects;
+    int number_of_processes;
+    int number_of_threads;
+    int number_of_containers;
+    int iterations;
+    int random_access;
+    int lock_mode;
+    int json;
+    int header;
+    int keep_mapped;
+    int reserve;
+    int first_cid;
+};
+
+// samples of one worker thread, stored in memory shared by all processes
+struct worker
+{
+    struct config *config;
+    int devfd;
+    int worker_id;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t *samples[NUMBER_OF_STEPS];
+};
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int _compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t _percentile(uint64_t *sorted, size_t count, double p)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    return sorted[(size_t)(p * (count - 1) + 0.5)];
+}
+
+/**
+ * Fills 'length' bytes with the decimal digits of 'a' repeated and
+ * terminates the string, the payload the original benchmark built
+ * with repeated sprintf()
+ */
+static void _fill_payload(char *buffer, int length, int a)
+{
+    char digits[16];
+    int n = sprintf(digits, "%d", a), i;
+
+    for (i = 0; i + n <= length - 1; i += n)
+    {
+        memcpy(buffer + i, digits, n);
+    }
+    memcpy(buffer + i, digits, length - 1 - i);
+    buffer[length - 1] = '\0';
+}
+
+static void _lock(struct config *config, int devfd, __u64 offset)
+{
+    if (config->lock_mode == LOCK_IOCTL)
+    {
+        mcontainer_lock(devfd, offset);
+    }
+    else if (config->lock_mode == LOCK_FAST)
+    {
+        mcontainer_lock_fast(devfd, offset);
+    }
+    else if (config->lock_mode == LOCK_SHARED)
+    {
+        mcontainer_lock_shared(devfd, offset);
+    }
+}
+
+static void _unlock(struct config *config, int devfd, __u64 offset)
+{
+    if (config->lock_mode == LOCK_IOCTL || config->lock_mode == LOCK_SHARED)
+    {
+        mcontainer_unlock(devfd, offset);
+    }
+    else if (config->lock_mode == LOCK_FAST)
+    {
+        mcontainer_unlock_fast(devfd, offset);
+    }
+}
+
+/**
+ * Reads every word of an object, the touch of readers holding a shared lock
+ */
+static uint64_t _read_object(const char *mapped_data, int size)
+{
+    const volatile uint64_t *words = (const volatile uint64_t *)mapped_data;
+    uint64_t sum = 0;
+    int i;
+
+    for (i = 0; i < size / (int)sizeof(uint64_t); i++)
+    {
+        sum += words[i];
+    }
+    return sum;
+}
+
+/**
+ * Runs the timed loop of one worker thread
+ */
+static void *_run_worker(void *arg)
+{
+    struct worker *worker = (struct worker *)arg;
+    struct config *config = worker->config;
+    int number_of_objects = config->number_of_objects, size = config->max_size_of_objects;
+    int *order = (int *)malloc(number_of_objects * sizeof(int));
+    unsigned int seed = (unsigned int)(worker->worker_id * 2654435761U + time(NULL));
+    uint64_t t0, t1, t2, t3, t4;
+    size_t sample = 0;
+    char *mapped_data;
+    int i, j, k, tmp;
+
+    for (i = 0; i < number_of_objects; i++)
+    {
+        order[i] = i;
+    }
+
+    worker->start_ns = _now_ns();
+    for (k = 0; k < config->iterations; k++)
+    {
+        if (config->random_access)
+        {
+            for (i = number_of_objects - 1; i > 0; i--)
+            {
+                j = rand_r(&seed) % (i + 1);
+                tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+            }
+        }
+
+        for (i = 0; i < number_of_objects; i++, sample++)
+        {
+            t0 = _now_ns();
+            _lock(config, worker->devfd, order[i]);
+            t1 = _now_ns();
+            mapped_data = (char *)mcontainer_alloc(worker->devfd, order[i], size);
+            t2 = _now_ns();
+            if (mapped_data == MAP_FAILED)
+            {
+                fprintf(stderr, "Failed in mcontainer_alloc()\n");
+                exit(1);
+            }
+            if (config->lock_mode == LOCK_SHARED)
+            {
+                _read_object(mapped_data, size);
+            }
+            else
+            {
+                memset(mapped_data, 'a' + (i % 26), size);
+            }
+            t3 = _now_ns();
+            _unlock(config, worker->devfd, order[i]);
+            t4 = _now_ns();
+            if (!config->keep_mapped)
+            {
+                mcontainer_unmap(worker->devfd, order[i]);
+            }
+
+            worker->samples[STEP_LOCK][sample] = t1 - t0;
+            worker->samples[STEP_ALLOC][sample] = t2 - t1;
+            worker->samples[STEP_TOUCH][sample] = t3 - t2;
+            worker->samples[STEP_UNLOCK][sample] = t4 - t3;
+            worker->samples[STEP_TOTAL][sample] = t4 - t0;
+        }
+    }
+    worker->end_ns = _now_ns();
+
+    free(order);
+    return NULL;
+}
+
+/**
+ * Sorts the samples of every worker for each step and prints percentiles
+ */
+static void _report(struct config *config, struct worker *workers, int number_of_workers)
+{
+    size_t per_worker = (size_t)config->number_of_objects * config->iterations;
+    size_t count = per_worker * number_of_workers;
+    uint64_t *all = (uint64_t *)malloc(count * sizeof(uint64_t));
+    uint64_t start_ns = workers[0].start_ns, end_ns = workers[0].end_ns, sum;
+    double seconds, mean;
+    size_t i;
+    int step, w;
+
+    for (w = 1; w < number_of_workers; w++)
+    {
+        start_ns = workers[w].start_ns < start_ns ? workers[w].start_ns : start_ns;
+        end_ns = workers[w].end_ns > end_ns ? workers[w].end_ns : end_ns;
+    }
+    seconds = (end_ns - start_ns) / 1e9;
+
+    if (config->json)
+    {
+        printf("{\"objects\": %d, \"size\": %d, \"processes\": %d, \"threads\": %d, \"containers\": %d, "
+               "\"iterations\": %d, \"pattern\": \"%s\", \"lock\": \"%s\", \"keep_mapped\": %d, \"reserve\": %d, "
+               "\"seconds\": %.6f, \"results\": [",
+               config->number_of_objects, config->max_size_of_objects, config->number_of_processes,
+               config->number_of_threads, config->number_of_containers, config->iterations,
+               config->random_access ? "random" : "seq", lock_mode_names[config->lock_mode], config->keep_mapped,
+               config->reserve, seconds);
+    }
+    else if (config->header)
+    {
+        printf("objects,size,processes,threads,containers,iterations,pattern,lock,op,samples,mean_ns,p50_ns,p99_ns,p999_ns,max_ns,ops_per_sec\n");
+    }
+
+    for (step = 0; step < NUMBER_OF_STEPS; step++)
+    {
+        sum = 0;
+        for (w = 0; w < number_of_workers; w++)
+        {
+            memcpy(all + w * per_worker, workers[w].samples[step], per_worker * sizeof(uint64_t));
+        }
+        for (i = 0; i < count; i++)
+        {
+            sum += all[i];
+        }
+        qsort(all, count, sizeof(uint64_t), _compare_u64);
+        mean = count ? (double)sum / count : 0;
+
+        if (config->json)
+        {
+            printf("%s{\"op\": \"%s\", \"samples\": %zu, \"mean_ns\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+                   "\"p999_ns\": %llu, \"max_ns\": %llu, \"ops_per_sec\": %.1f}",
+                   step ? ", " : "", step_names[step], count, mean,
+                   (unsigned long long)_percentile(all, count, 0.5), (unsigned long long)_percentile(all, count, 0.99),
+                   (unsigned long long)_percentile(all, count, 0.999), (unsigned long long)(count ? all[count - 1] : 0),
+                   count / seconds);
+        }
+        else
+        {
+            printf("%d,%d,%d,%d,%d,%d,%s,%s,%s,%zu,%.1f,%llu,%llu,%llu,%llu,%.1f\n",
+                   config->number_of_objects, config->max_size_of_objects, config->number_of_processes,
+                   config->number_of_threads, config->number_of_containers, config->iterations,
+                   config->random_access ? "random" : "seq", lock_mode_names[config->lock_mode],
+                   step_names[step], count, mean,
+                   (unsigned long long)_percentile(all, count, 0.5), (unsigned long long)_percentile(all, count, 0.99),
+                   (unsigned long long)_percentile(all, count, 0.999), (unsigned long long)(count ? all[count - 1] : 0),
+                   count / seconds);
+        }
+    }
+    if (config->json)
+    {
+        printf("]}\n");
+    }
+    free(all);
+}
+
+/**
+ * Forks the worker processes, each joins a container and starts its threads
+ */
+static int _run_harness(struct config *config)
+{
+    int number_of_workers = config->number_of_processes * config->number_of_threads;
+    size_t per_worker = (size_t)config->number_of_objects * config->iterations;
+    size_t shared_size = number_of_workers * (sizeof(struct worker) + NUMBER_OF_STEPS * per_worker * sizeof(uint64_t));
+    struct worker *workers;
+    pthread_barrierattr_t attr;
+    pthread_barrier_t *done;
+    pthread_t *threads;
+    uint64_t *samples;
+    pid_t *pid;
+    int i, t, w, step, stat, devfd, cid, process = 0;
+
+    // workers and their samples are shared, so the parent can report all of them
+    workers = (struct worker *)mmap(0, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (workers == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to allocate %zu bytes for samples\n", shared_size);
+        exit(1);
+    }
+    samples = (uint64_t *)(workers + number_of_workers);
+    for (w = 0; w < number_of_workers; w++)
+    {
+        workers[w].config = config;
+        workers[w].worker_id = w;
+        for (step = 0; step < NUMBER_OF_STEPS; step++)
+        {
+            workers[w].samples[step] = samples + (w * NUMBER_OF_STEPS + step) * per_worker;
+        }
+    }
+
+    // processes wait for each other here before objects are freed
+    done = (pthread_barrier_t *)mmap(0, sizeof(pthread_barrier_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (done == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to allocate the process barrier\n");
+        exit(1);
+    }
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(done, &attr, config->number_of_processes);
+    pthread_barrierattr_destroy(&attr);
+
+    pid = (pid_t *)calloc(config->number_of_processes, sizeof(pid_t));
+    for (i = 1; i < config->number_of_processes; i++)
+    {
+        pid[i] = fork();
+        if (pid[i] == 0)
+        {
+            process = i;
+            break;
+        }
+    }
+
+    // each process opens its own device file, so children do not share the parent's
+    devfd = open("/dev/mcontainer", O_RDWR);
+    if (devfd < 0)
+    {
+        fprintf(stderr, "Device open failed");
+        exit(1);
+    }
+    cid = config->first_cid + process % config->number_of_containers;
+    if (config->reserve)
+    {
+        // room for every object of the container, each rounded up to pages
+        __u64 page_size = sysconf(_SC_PAGESIZE);
+        __u64 object_bytes = (config->max_size_of_objects + page_size - 1) / page_size * page_size;
+        if (mcontainer_create_reserved(devfd, cid, 0, object_bytes * config->number_of_objects) < 0)
+        {
+            perror("mcontainer_create_reserved");
+            exit(1);
+        }
+    }
+    else
+    {
+        mcontainer_create(devfd, cid);
+    }
+
+    threads = (pthread_t *)calloc(config->number_of_threads, sizeof(pthread_t));
+    for (t = 0; t < config->number_of_threads; t++)
+    {
+        workers[process * config->number_of_threads + t].devfd = devfd;
+        pthread_create(&threads[t], NULL, _run_worker, &workers[process * config->number_of_threads + t]);
+    }
+    for (t = 0; t < config->number_of_threads; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+
+    // the first process of each container frees its objects once every
+    // process is done, so a later run can map them with another size
+    pthread_barrier_wait(done);
+    if (process < config->number_of_containers)
+    {
+        for (i = 0; i < config->number_of_objects; i++)
+        {
+            mcontainer_free(devfd, i);
+        }
+    }
+
+    mcontainer_delete(devfd);
+    close(devfd);
+
+    if (process != 0)
+    {
+        exit(0);
+    }
+    for (i = 1; i < config->number_of_processes; i++)
+    {
+        waitpid(pid[i], &stat, 0);
+    }
+
+    _report(config, workers, number_of_workers);
+    pthread_barrier_destroy(done);
+    munmap(done, sizeof(pthread_barrier_t));
+    munmap(workers, shared_size);
+    free(pid);
+    return 0;
+}
+
+// records buffered between flushes of the binary log
+#define LOG_BUFFER_RECORDS 4096
+
+struct log_writer
+{
+    int binary;
+    FILE *fp;
+    size_t used;
+    struct mcontainer_log_record records[LOG_BUFFER_RECORDS];
+};
+
+static void _log_flush(struct log_writer *log)
+{
+    if (log->used > 0)
+    {
+        fwrite(log->records, sizeof(struct mcontainer_log_record), log->used, log->fp);
+        log->used = 0;
+    }
+}
+
+static struct log_writer *_log_open(const char *filename, int binary)
+{
+    struct log_writer *log = (struct log_writer *)calloc(1, sizeof(struct log_writer));
+    struct mcontainer_log_header header = {MCONTAINER_LOG_MAGIC, MCONTAINER_LOG_VERSION,
+                                           sizeof(struct mcontainer_log_record), {0, 0, 0}};
+
+    log->binary = binary;
+    log->fp = fopen(filename, "w");
+    if (log->fp == NULL)
+    {
+        fprintf(stderr, "Cannot create log %s\n", filename);
+        exit(1);
+    }
+    if (binary)
+    {
+        fwrite(&header, sizeof(header), 1, log->fp);
+    }
+    return log;
+}
+
+static void _log_close(struct log_writer *log)
+{
+    _log_flush(log);
+    fclose(log->fp);
+    free(log);
+}
+
+/**
+ * Records an operation on an object. Binary records only go to the
+ * buffer, which the caller flushes with _log_flush_if_full() once it
+ * has released the object lock
+ */
+static void _log_record(struct log_writer *log, char op, int cid, struct timeval *current_time,
+                        int object_offset, int max_size_of_objects, const char *data)
+{
+    struct mcontainer_log_record *record;
+
+    if (!log->binary)
+    {
+        fprintf(log->fp, "%c\t%d\t%d\t%ld\t%d\t%d\t%s\n", op, getpid(), cid,
+                current_time->tv_sec * 1000000 + current_time->tv_usec, object_offset, max_size_of_objects, data);
+        return;
+    }
+
+    record = &log->records[log->used++];
+    memset(record, 0, sizeof(*record));
+    record->time = current_time->tv_sec * 1000000ULL + current_time->tv_usec;
+    record->oid = object_offset;
+    record->pid = getpid();
+    record->cid = cid;
+    record->size = max_size_of_objects;
+    record->op = op;
+    if (op == 'S')
+    {
+        record->checksum = mcontainer_log_checksum(data, max_size_of_objects - 1);
+    }
+}
+
+static void _log_flush_if_full(struct log_writer *log)
+{
+    if (log->used == LOG_BUFFER_RECORDS)
+    {
+        _log_flush(log);
+    }
 }
 
 void _test_mem_container(
-        int devfd, 
-        int object_offset, 
-        int max_size_of_objects, 
+        int devfd,
+        int object_offset,
+        int max_size_of_objects,
         struct timeval* current_time,
-        int max_size_of_objects_with_buffer,
-        FILE *log_file, 
+        struct log_writer *log,
         int cid) {
-    int j, a;
-    char *mapped_data, *data;
+    int a;
+    char *mapped_data;
 
     mcontainer_lock(devfd, object_offset);
     mapped_data = (char *)mcontainer_alloc(devfd, object_offset, max_size_of_objects);
-    
-    data = (char *) malloc(max_size_of_objects_with_buffer * sizeof(char));
 
     // error handling
-    if (!mapped_data)
+    if (mapped_data == MAP_FAILED)
     {
         fprintf(stderr, "Failed in mcontainer_alloc()\n");
         exit(1);
@@ -75,54 +577,29 @@ void _test_mem_container(
     // generate a random number to write into the object.
     a = rand() + 1;
 
-    // fprintf(stderr, "[Before] Container : %d, Offset : %d, Data : %s\n", cid, object_offset, mapped_data);
-
     // starts to write the data to that address.
     gettimeofday(current_time, NULL);
-    for (j = 0; j < max_size_of_objects_with_buffer - 10; j = strlen(data))
-    {
-        sprintf(data, "%s%d", data, a);
-    }
+    _fill_payload(mapped_data, max_size_of_objects, a);
 
-    strncpy(mapped_data, data, max_size_of_objects-1);
-    mapped_data[max_size_of_objects-1] = '\0';
-
-    // fprintf(stderr, "[After] Container : %d, Offset : %d, Data : %s\n", cid, object_offset, mapped_data);
-        
-    // fprintf(stderr, "___________________________________________________________________________________________\n");
-
-    fprintf(log_file, "S\t%d\t%d\t%ld\t%d\t%d\t%s\n", getpid(), cid, current_time->tv_sec * 1000000 + current_time->tv_usec, object_offset, max_size_of_objects, mapped_data);
+    _log_record(log, 'S', cid, current_time, object_offset, max_size_of_objects, mapped_data);
     mcontainer_unlock(devfd, object_offset);
-    memset(data, 0, max_size_of_objects_with_buffer);
+    _log_flush_if_full(log);
 }
 
-int main(int argc, char *argv[])
+/**
+ * The original workload: every process writes a random payload to each
+ * object, logs it for validate and finally deletes object 0
+ */
+static int _run_legacy(int number_of_objects, int max_size_of_objects, int number_of_processes, int number_of_containers, int binary)
 {
-    // variable initialization
-    int i = 0; 
-    int number_of_processes = 1, number_of_objects = 1024, max_size_of_objects = 8192, number_of_containers = 1;
-    int a, j, cid, size, stat, child_pid, devfd, max_size_of_objects_with_buffer;
+    int i = 0;
+    int cid, stat, child_pid = 1, devfd;
     char filename[256];
-    char *mapped_data, *data;
-    unsigned long long msec_time;
-    FILE *fp;
+    struct log_writer *log;
     struct timeval current_time;
-    pid_t *pid; 
-
-    // takes arguments from command line interface.
-    if (argc < 4)
-    {
-        fprintf(stderr, "Usage: %s number_of_objects max_size_of_objects number_of_processes number_of_containers\n", argv[0]);
-        exit(1);
-    }
+    pid_t *pid;
 
-    number_of_objects = atoi(argv[1]);
-    max_size_of_objects = atoi(argv[2]);
-    number_of_processes = atoi(argv[3]);
-    number_of_containers = atoi(argv[4]);
-
-    max_size_of_objects_with_buffer = max_size_of_objects + 100;
-    pid = (pid_t *) calloc(number_of_processes - 1, sizeof(pid_t));
+    pid = (pid_t *) calloc(number_of_processes, sizeof(pid_t));
 
     // open the kernel module to use it
     devfd = open("/dev/mcontainer", O_RDWR);
@@ -146,12 +623,10 @@ int main(int argc, char *argv[])
         }
     }
 
-    data = (char *) malloc(max_size_of_objects_with_buffer * sizeof(char));
-
     // create the log file
     srand((int)time(NULL) + (int)getpid());
     sprintf(filename, "mcontainer.%d.log", (int)getpid());
-    fp = fopen(filename, "w");
+    log = _log_open(filename, binary);
 
     // create/link this process to a container.
     cid = getpid() % number_of_containers;
@@ -160,7 +635,7 @@ int main(int argc, char *argv[])
     // Writing to objects
     for (i = 0; i < number_of_objects; i++)
     {
-        _test_mem_container(devfd, i, max_size_of_objects, &current_time, max_size_of_objects_with_buffer, fp, cid);
+        _test_mem_container(devfd, i, max_size_of_objects, &current_time, log, cid);
     }
 
     // try delete something
@@ -168,9 +643,10 @@ int main(int argc, char *argv[])
     mcontainer_lock(devfd, i);
     gettimeofday(&current_time, NULL);
     mcontainer_free(devfd, i);
-    fprintf(fp, "D\t%d\t%d\t%ld\t%d\t%d\t%s\n", getpid(), cid, current_time.tv_sec * 1000000 + current_time.tv_usec, i, max_size_of_objects, "delete an object");
+    _log_record(log, 'D', cid, &current_time, i, max_size_of_objects, "delete an object");
     mcontainer_unlock(devfd, i);
-    
+    _log_close(log);
+
     // done with works, cleanup and wait for other processes.
     mcontainer_delete(devfd);
     close(devfd);
@@ -179,11 +655,85 @@ int main(int argc, char *argv[])
     {
         for (i = 0; i < (number_of_processes - 1); i++)
         {
-            waitpid(pid[i], &stat, 0);  
+            waitpid(pid[i], &stat, 0);
         }
     }
 
     free(pid);
-    free(data);
     return 0;
 }
+
+static void _usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "       %s number_of_objects max_size_of_objects number_of_processes number_of_containers\n"
+            "  -o objects      objects per container (1024)\n"
+            "  -s size         object size in bytes (8192)\n"
+            "  -p processes    worker processes (1)\n"
+            "  -t threads      threads per process (1)\n"
+            "  -c containers   containers, process i joins container cid + i %% containers (1)\n"
+            "  -b cid          id of the first container (0)\n"
+            "  -i iterations   passes over all objects (1)\n"
+            "  -a seq|random   order objects are visited in (seq)\n"
+            "  -l ioctl|fast|none|shared  lock implementation, shared only reads objects (ioctl)\n"
+            "  -f csv|json     output format (csv)\n"
+            "  -n              no CSV header\n"
+            "  -k              keep objects mapped, later passes hit the library mapping cache\n"
+            "  -r              reserve memory for all objects when creating containers\n"
+            "  -P legacy       original workload with -o -s -p -c, logging to mcontainer.<pid>.log\n"
+            "  -L binary|text  log format of the original workload (binary)\n",
+            name, name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct config config = {1024, 8192, 1, 1, 1, 1, 0, LOCK_IOCTL, 0, 1, 0, 0, 0};
+    int opt, legacy = 0, binary = 1;
+
+    // the original command line runs the original workload
+    if (argc == 5 && argv[1][0] != '-')
+    {
+        return _run_legacy(atoi(argv[1]), atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), binary);
+    }
+
+    while ((opt = getopt(argc, argv, "o:s:p:t:c:b:i:a:l:f:nkrP:L:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o': config.number_of_objects = atoi(optarg); break;
+        case 's': config.max_size_of_objects = atoi(optarg); break;
+        case 'p': config.number_of_processes = atoi(optarg); break;
+        case 't': config.number_of_threads = atoi(optarg); break;
+        case 'c': config.number_of_containers = atoi(optarg); break;
+        case 'b': config.first_cid = atoi(optarg); break;
+        case 'i': config.iterations = atoi(optarg); break;
+        case 'a': config.random_access = strcmp(optarg, "random") == 0; break;
+        case 'l':
+            config.lock_mode = strcmp(optarg, "fast") == 0 ? LOCK_FAST : strcmp(optarg, "none") == 0 ? LOCK_NONE :
+                               strcmp(optarg, "shared") == 0 ? LOCK_SHARED : LOCK_IOCTL;
+            break;
+        case 'f': config.json = strcmp(optarg, "json") == 0; break;
+        case 'n': config.header = 0; break;
+        case 'k': config.keep_mapped = 1; break;
+        case 'r': config.reserve = 1; break;
+        case 'P': legacy = strcmp(optarg, "legacy") == 0; break;
+        case 'L': binary = strcmp(optarg, "text") != 0; break;
+        default: _usage(argv[0]);
+        }
+    }
+
+    if (config.number_of_objects < 1 || config.max_size_of_objects < 1 || config.number_of_processes < 1 ||
+        config.number_of_threads < 1 || config.number_of_containers < 1 || config.iterations < 1 ||
+        config.first_cid < 0)
+    {
+        _usage(argv[0]);
+    }
+
+    if (legacy)
+    {
+        return _run_legacy(config.number_of_objects, config.max_size_of_objects, config.number_of_processes, config.number_of_containers, binary);
+    }
+    return _run_harness(&config);
+}
@@ -0,0 +1,145 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Random Access Throughput on 4 KiB and 2 MiB Backed Objects
+//
+//     Maps one large object from a regular container and one from a
+//     container created with MCONTAINER_CREATE_HUGEPAGE, touches every
+//     page, then times random 8 byte reads and writes over each.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <mcontainer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// object offset in pages, a multiple of 512 so that 2 MiB chunks line up
+#define OBJECT_OFFSET 512
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * xorshift, cheap enough not to dominate the access loop
+ */
+static inline uint64_t _next_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void _run(int devfd, int cid, __u64 flags, const char *mode, size_t object_size, long number_of_accesses)
+{
+    uint64_t *mapped_data, state = 88172645463325252ULL, sum = 0;
+    size_t words = object_size / sizeof(uint64_t), i;
+    unsigned long long start, touch_ns, access_ns;
+    long j;
+
+    if (mcontainer_create_with_flags(devfd, cid, flags) < 0)
+    {
+        fprintf(stderr, "Failed in mcontainer_create()\n");
+        exit(1);
+    }
+    mapped_data = (uint64_t *)mcontainer_alloc(devfd, OBJECT_OFFSET, object_size);
+    if (mapped_data == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed in mcontainer_alloc()\n");
+        exit(1);
+    }
+
+    // first touch populates the object
+    start = _now_ns();
+    for (i = 0; i < words; i += getpagesize() / sizeof(uint64_t))
+    {
+        mapped_data[i] = i;
+    }
+    touch_ns = _now_ns() - start;
+
+    start = _now_ns();
+    for (j = 0; j < number_of_accesses; j++)
+    {
+        i = _next_random(&state) % words;
+        sum += mapped_data[i];
+        mapped_data[i] = sum;
+    }
+    access_ns = _now_ns() - start;
+
+    printf("%s,%zu,%llu,%ld,%llu,%.2f,%.1f\n", mode, object_size, touch_ns, number_of_accesses, access_ns,
+           (double)access_ns / number_of_accesses, number_of_accesses * 1e3 / access_ns);
+
+    mcontainer_unmap(devfd, OBJECT_OFFSET);
+    mcontainer_free(devfd, OBJECT_OFFSET);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t object_size = 1UL << 30;
+    long number_of_accesses = 100000000;
+    int devfd, cid;
+
+    if (argc > 1)
+    {
+        object_size = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2)
+    {
+        number_of_accesses = atol(argv[2]);
+    }
+    if (object_size < (size_t)getpagesize() || number_of_accesses < 1)
+    {
+        fprintf(stderr, "Usage: %s [object_size_in_bytes] [number_of_accesses]\n", argv[0]);
+        exit(1);
+    }
+
+    devfd = open("/dev/mcontainer", O_RDWR);
+    if (devfd < 0)
+    {
+        fprintf(stderr, "Device open failed");
+        exit(1);
+    }
+
+    cid = getpid() * 2;
+    printf("mode,object_size,touch_ns,accesses,access_ns,ns_per_access,maccesses_per_sec\n");
+    _run(devfd, cid, 0, "4k", object_size, number_of_accesses);
+    _run(devfd, cid + 1, MCONTAINER_CREATE_HUGEPAGE, "2m", object_size, number_of_accesses);
+
+    mcontainer_delete(devfd);
+    close(devfd);
+    return 0;
+}
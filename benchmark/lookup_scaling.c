@@ -0,0 +1,142 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Object Lookup Scaling of Memory Container
+//
+//     Grows a single container from 1 to max_objects objects in
+//     powers of ten and, at every step, times mcontainer_alloc() of
+//     randomly chosen objects that already exist. With an indexed
+//     object store the per-lookup latency stays flat as it grows.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <mcontainer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static unsigned long long _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Maps and unmaps an object, creating it if it does not exist
+ * Mappings are dropped right away so that large runs stay
+ * below vm.max_map_count, and so that every lookup reaches
+ * the kernel rather than the library mapping cache
+ */
+static int _touch_object(int devfd, __u64 offset, int page_size)
+{
+    char *mapped_data = (char *)mcontainer_alloc(devfd, offset, page_size);
+    if (mapped_data == MAP_FAILED)
+    {
+        return -1;
+    }
+    mcontainer_unmap(devfd, offset);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long max_objects = 1000000, number_of_lookups = 10000;
+    long populated = 0, step, i;
+    int devfd, cid, page_size = getpagesize();
+    unsigned long long start, elapsed;
+
+    if (argc > 1)
+    {
+        max_objects = atol(argv[1]);
+    }
+    if (argc > 2)
+    {
+        number_of_lookups = atol(argv[2]);
+    }
+    if (max_objects < 1 || number_of_lookups < 1)
+    {
+        fprintf(stderr, "Usage: %s [max_number_of_objects] [number_of_lookups]\n", argv[0]);
+        exit(1);
+    }
+
+    devfd = open("/dev/mcontainer", O_RDWR);
+    if (devfd < 0)
+    {
+        fprintf(stderr, "Device open failed");
+        exit(1);
+    }
+
+    // a fresh container so that earlier runs do not skew the index size
+    srand((int)time(NULL) + (int)getpid());
+    cid = getpid();
+    mcontainer_create(devfd, cid);
+
+    printf("objects,lookups,total_ns,ns_per_lookup\n");
+    for (step = 1; ; step *= 10)
+    {
+        if (step > max_objects)
+        {
+            step = max_objects;
+        }
+
+        // grow the container up to the current step
+        for (; populated < step; populated++)
+        {
+            if (_touch_object(devfd, populated, page_size) < 0)
+            {
+                fprintf(stderr, "Failed in mcontainer_alloc() at object %ld\n", populated);
+                exit(1);
+            }
+        }
+
+        start = _now_ns();
+        for (i = 0; i < number_of_lookups; i++)
+        {
+            _touch_object(devfd, rand() % populated, page_size);
+        }
+        elapsed = _now_ns() - start;
+
+        printf("%ld,%ld,%llu,%.1f\n", populated, number_of_lookups, elapsed, (double)elapsed / number_of_lookups);
+        fflush(stdout);
+
+        if (step == max_objects)
+        {
+            break;
+        }
+    }
+
+    for (i = 0; i < populated; i++)
+    {
+        mcontainer_free(devfd, i);
+    }
+    mcontainer_delete(devfd);
+    close(devfd);
+    return 0;
+}
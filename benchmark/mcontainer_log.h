@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Binary Log Format of the Benchmark
+//
+//     A log is a header followed by fixed-size records, one per S or D
+//     line of the text log. Records carry a checksum of the payload
+//     instead of the payload. The header has the size of a record, so
+//     concatenated logs can be read as one stream of records.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef MCONTAINER_LOG_H
+#define MCONTAINER_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// "\x7fMCLOG" in little endian, the first byte never starts a text log
+#define MCONTAINER_LOG_MAGIC 0x00474f4c434d7fULL
+#define MCONTAINER_LOG_VERSION 1
+
+struct mcontainer_log_header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t reserved[3];
+};
+
+struct mcontainer_log_record
+{
+    uint64_t time;
+    uint64_t oid;
+    uint64_t checksum;
+    int32_t pid;
+    int32_t cid;
+    uint32_t size;
+    char op;
+    char reserved[3];
+};
+
+typedef char mcontainer_log_header_matches_record[
+        sizeof(struct mcontainer_log_header) == sizeof(struct mcontainer_log_record) ? 1 : -1];
+
+/**
+ * FNV-1a of a payload, of its bytes up to the terminating NUL
+ */
+static inline uint64_t mcontainer_log_checksum(const char *data, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#endif
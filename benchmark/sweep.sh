@@ -0,0 +1,114 @@
+#!/bin/bash
+#
+# Scaling sweep of Memory Container
+#
+# Runs the benchmark harness over the axes of the README (objects,
+# object size, tasks and containers), writes one CSV per run to
+# results/ and compares it against baseline.csv. The sweep fails when
+#
+#   - p50 latency or ops/sec of any point and step is more than
+#     TOLERANCE percent worse than the baseline, or
+#   - the per-object latency grows by more than CLIFF_FACTOR from the
+#     smallest to the largest point of the objects axis, which is what
+#     a linear walk per lookup looks like.
+#
+#   ./sweep.sh            run, compare against baseline.csv
+#   ./sweep.sh baseline   run and store the result as baseline.csv
+#
+# Environment: ITERATIONS (3), LOCK (ioctl), TOLERANCE (25),
+# CLIFF_FACTOR (4), BASELINE (baseline.csv), RESULTS (results)
+
+set -o pipefail
+cd "$(dirname "$0")" || exit 1
+
+ITERATIONS=${ITERATIONS:-3}
+LOCK=${LOCK:-ioctl}
+TOLERANCE=${TOLERANCE:-25}
+CLIFF_FACTOR=${CLIFF_FACTOR:-4}
+BASELINE=${BASELINE:-baseline.csv}
+RESULTS=${RESULTS:-results}
+
+# axis objects size tasks containers
+POINTS="
+tasks 128 4096 1 1
+tasks 128 4096 2 1
+tasks 128 4096 4 1
+objects 128 4096 1 1
+objects 512 4096 1 1
+objects 1024 4096 1 1
+objects 4096 4096 1 1
+size 128 4096 1 1
+size 128 8192 1 1
+containers 128 4096 2 2
+containers 128 4096 8 8
+containers 128 4096 64 64
+combination 256 8192 8 4
+"
+
+mkdir -p "$RESULTS"
+result="$RESULTS/sweep.$(date +%Y%m%d-%H%M%S).csv"
+
+echo "axis,objects,size,processes,threads,containers,iterations,pattern,lock,op,samples,mean_ns,p50_ns,p99_ns,p999_ns,max_ns,ops_per_sec" > "$result"
+# every point runs in containers of its own, none is left over from an
+# earlier point with objects of another size
+first_cid=0
+echo "$POINTS" | while read -r axis objects size tasks containers; do
+    [ -z "$axis" ] && continue
+    echo "sweep: $axis objects=$objects size=$size tasks=$tasks containers=$containers" >&2
+    if ! ./benchmark -n -o "$objects" -s "$size" -p "$tasks" -c "$containers" -b "$first_cid" \
+            -i "$ITERATIONS" -l "$LOCK" -f csv | sed "s/^/$axis,/" >> "$result"; then
+        echo "sweep: benchmark failed at $axis $objects $size $tasks $containers" >&2
+        exit 1
+    fi
+    first_cid=$((first_cid + containers))
+done || exit 1
+
+echo "sweep: results in $result" >&2
+
+if [ "$1" = "baseline" ]; then
+    cp "$result" "$BASELINE"
+    echo "sweep: stored $BASELINE" >&2
+    exit 0
+fi
+
+# per-object latency along the objects axis must stay roughly flat
+awk -F, -v cliff="$CLIFF_FACTOR" '
+    NR > 1 && $1 == "objects" && $10 == "total" {
+        if (min == "" || $2 < min) { min = $2; min_p50 = $13 }
+        if (max == "" || $2 > max) { max = $2; max_p50 = $13 }
+    }
+    END {
+        if (min_p50 > 0 && max_p50 > cliff * min_p50) {
+            printf "FAIL: scaling cliff, total p50 %d ns at %d objects vs %d ns at %d objects\n", max_p50, max, min_p50, min
+            exit 1
+        }
+    }' "$result" || failed=1
+
+if [ ! -f "$BASELINE" ]; then
+    echo "sweep: no $BASELINE, run './sweep.sh baseline' on the reference machine to store one" >&2
+    exit ${failed:-0}
+fi
+
+# points are keyed by axis, configuration and step
+awk -F, -v tolerance="$TOLERANCE" '
+    FNR == 1 { next }
+    { key = $1 FS $2 FS $3 FS $4 FS $5 FS $6 FS $7 FS $8 FS $9 FS $10 }
+    NR == FNR { p50[key] = $13; ops[key] = $17; next }
+    key in p50 {
+        limit = 1 + tolerance / 100
+        if (p50[key] > 0 && $13 > p50[key] * limit) {
+            printf "FAIL: %s p50 %d ns, baseline %d ns\n", key, $13, p50[key]
+            failed = 1
+        }
+        if ($17 * limit < ops[key]) {
+            printf "FAIL: %s %.1f ops/sec, baseline %.1f ops/sec\n", key, $17, ops[key]
+            failed = 1
+        }
+    }
+    END { exit failed }' "$BASELINE" "$result" || failed=1
+
+if [ -n "$failed" ]; then
+    echo "sweep: REGRESSION against $BASELINE, see $result" >&2
+    exit 1
+fi
+echo "sweep: no regression against $BASELINE" >&2
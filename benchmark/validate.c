@@ -27,11 +27,20 @@
 //   Description:
 //     Validating the Results of Memory Container
 //
+//     Replays the benchmark logs and keeps only a hash of the latest
+//     payload of every (cid, oid), so memory use follows the number
+//     of objects in the logs rather than containers x objects x size.
+//     Log files given on the command line are mmapped and merged in
+//     time order; without them a time-ordered log is read from stdin.
+//     Text and binary logs (mcontainer_log.h) are both accepted.
+//
 ////////////////////////////////////////////////////////////////////////
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <sys/syscall.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <mcontainer.h>
 #include <fcntl.h>
@@ -39,23 +48,360 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/wait.h>
+#include "mcontainer_log.h"
+
+struct log_record
+{
+    char op;
+    int cid;
+    __u64 time;
+    __u64 oid;
+    uint64_t hash;
+};
+
+// one text or binary log, either mmapped or read from a pipe
+struct log_stream
+{
+    int binary;
+    const char *cursor;
+    const char *end;
+    void *map;
+    size_t map_size;
+    FILE *fp;
+    char *line;
+    size_t line_size;
+    int valid;
+    struct log_record record;
+};
+
+struct object_entry
+{
+    int used;
+    int cid;
+    __u64 oid;
+    uint64_t hash;
+};
+
+// open addressing table of the latest payload hash per (cid, oid)
+static struct object_entry *objects;
+static size_t objects_size, objects_used;
+
+static size_t _hash_key(int cid, __u64 oid)
+{
+    uint64_t x = ((uint64_t)(unsigned int)cid << 32) ^ oid;
+
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+static struct object_entry *_find_entry(struct object_entry *table, size_t size, int cid, __u64 oid)
+{
+    size_t i = _hash_key(cid, oid) & (size - 1);
+
+    while (table[i].used && (table[i].cid != cid || table[i].oid != oid))
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &table[i];
+}
+
+/**
+ * Returns the entry of (cid, oid), adding it and growing the table at half load
+ */
+static struct object_entry *_get_entry(int cid, __u64 oid)
+{
+    struct object_entry *entry, *table;
+    size_t i, size;
+
+    if (2 * (objects_used + 1) > objects_size)
+    {
+        size = objects_size ? 2 * objects_size : 1024;
+        table = (struct object_entry *)calloc(size, sizeof(struct object_entry));
+        if (table == NULL)
+        {
+            fprintf(stderr, "Out of memory for %zu objects\n", objects_used);
+            exit(1);
+        }
+        for (i = 0; i < objects_size; i++)
+        {
+            if (objects[i].used)
+            {
+                *_find_entry(table, size, objects[i].cid, objects[i].oid) = objects[i];
+            }
+        }
+        free(objects);
+        objects = table;
+        objects_size = size;
+    }
+
+    entry = _find_entry(objects, objects_size, cid, oid);
+    if (!entry->used)
+    {
+        entry->used = 1;
+        entry->cid = cid;
+        entry->oid = oid;
+        objects_used++;
+    }
+    return entry;
+}
+
+/**
+ * Parses a decimal number with an optional sign from [*cursor, end),
+ * skipping blanks before it, and moves *cursor past it. Never reads
+ * at or past end, mapped logs are not NUL terminated
+ */
+static int _parse_number(const char **cursor, const char *end, long long *value)
+{
+    const char *next = *cursor;
+    unsigned long long number = 0;
+    int negative = 0;
+
+    while (next < end && (*next == ' ' || *next == '\t'))
+    {
+        next++;
+    }
+    if (next < end && (*next == '-' || *next == '+'))
+    {
+        negative = *next == '-';
+        next++;
+    }
+    if (next >= end || *next < '0' || *next > '9')
+    {
+        return -1;
+    }
+    while (next < end && *next >= '0' && *next <= '9')
+    {
+        number = number * 10 + (*next - '0');
+        next++;
+    }
+    *value = negative ? -(long long)number : (long long)number;
+    *cursor = next;
+    return 0;
+}
+
+/**
+ * Parses "op pid cid time oid size data" from [line, end)
+ */
+static int _parse_record(const char *line, const char *end, struct log_record *record)
+{
+    const char *data, *next;
+    long long pid, cid, time, oid, size;
+
+    while (line < end && (*line == ' ' || *line == '\t'))
+    {
+        line++;
+    }
+    if (line >= end)
+    {
+        return -1;
+    }
+    record->op = *line++;
+    next = line;
+    if (_parse_number(&next, end, &pid) || _parse_number(&next, end, &cid) || _parse_number(&next, end, &time) ||
+        _parse_number(&next, end, &oid) || _parse_number(&next, end, &size))
+    {
+        return -1;
+    }
+    record->cid = (int)cid;
+    record->time = (__u64)time;
+    record->oid = (__u64)oid;
+
+    // the payload is a single token, as scanf("%s") read it
+    while (next < end && (*next == ' ' || *next == '\t'))
+    {
+        next++;
+    }
+    data = next;
+    while (next < end && *next != ' ' && *next != '\t' && *next != '\n' && *next != '\r')
+    {
+        next++;
+    }
+    record->hash = mcontainer_log_checksum(data, next - data);
+    return 0;
+}
+
+/**
+ * Converts a binary record, returning -1 for the headers of concatenated logs
+ */
+static int _load_record(const struct mcontainer_log_record *raw, struct log_record *record)
+{
+    if (raw->time == MCONTAINER_LOG_MAGIC)
+    {
+        return -1;
+    }
+    record->op = raw->op;
+    record->cid = raw->cid;
+    record->time = raw->time;
+    record->oid = raw->oid;
+    record->hash = raw->checksum;
+    return 0;
+}
+
+static void _next_binary_record(struct log_stream *stream)
+{
+    struct mcontainer_log_record raw;
 
+    if (stream->fp != NULL)
+    {
+        while (fread(&raw, sizeof(raw), 1, stream->fp) == 1)
+        {
+            if (_load_record(&raw, &stream->record) == 0)
+            {
+                stream->valid = 1;
+                return;
+            }
+        }
+        return;
+    }
+
+    while (stream->cursor + sizeof(raw) <= stream->end)
+    {
+        memcpy(&raw, stream->cursor, sizeof(raw));
+        stream->cursor += sizeof(raw);
+        if (_load_record(&raw, &stream->record) == 0)
+        {
+            stream->valid = 1;
+            return;
+        }
+    }
+}
+
+/**
+ * Advances the stream to its next record, clearing valid at the end
+ */
+static void _next_record(struct log_stream *stream)
+{
+    const char *line, *newline;
+    ssize_t length;
+
+    stream->valid = 0;
+    if (stream->binary)
+    {
+        _next_binary_record(stream);
+        return;
+    }
+    if (stream->fp != NULL)
+    {
+        while ((length = getline(&stream->line, &stream->line_size, stream->fp)) > 0)
+        {
+            if (_parse_record(stream->line, stream->line + length, &stream->record) == 0)
+            {
+                stream->valid = 1;
+                return;
+            }
+        }
+        return;
+    }
+
+    while (stream->cursor < stream->end)
+    {
+        line = stream->cursor;
+        newline = (const char *)memchr(line, '\n', stream->end - line);
+        stream->cursor = newline ? newline + 1 : stream->end;
+        if (_parse_record(line, newline ? newline : stream->end, &stream->record) == 0)
+        {
+            stream->valid = 1;
+            return;
+        }
+    }
+}
+
+static void _open_stream(struct log_stream *stream, const char *filename)
+{
+    struct stat st;
+    int fd;
+
+    memset(stream, 0, sizeof(*stream));
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        fprintf(stderr, "Cannot open log %s\n", filename);
+        exit(1);
+    }
+    if (st.st_size > 0)
+    {
+        stream->map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (stream->map == MAP_FAILED)
+        {
+            fprintf(stderr, "Cannot map log %s\n", filename);
+            exit(1);
+        }
+        madvise(stream->map, st.st_size, MADV_SEQUENTIAL);
+        stream->map_size = st.st_size;
+        stream->cursor = (const char *)stream->map;
+        stream->end = stream->cursor + st.st_size;
+        stream->binary = st.st_size >= (off_t)sizeof(struct mcontainer_log_header) &&
+                         ((const struct mcontainer_log_header *)stream->map)->magic == MCONTAINER_LOG_MAGIC;
+    }
+    close(fd);
+    _next_record(stream);
+}
+
+static void _close_stream(struct log_stream *stream)
+{
+    if (stream->map != NULL)
+    {
+        munmap(stream->map, stream->map_size);
+    }
+    free(stream->line);
+}
+
+/**
+ * Replays all streams, always taking the earliest record next
+ */
+static void _replay(struct log_stream *streams, int number_of_streams)
+{
+    struct log_stream *earliest;
+    struct object_entry *entry;
+    uint64_t empty = mcontainer_log_checksum("", 0);
+    int i;
+
+    for (;;)
+    {
+        earliest = NULL;
+        for (i = 0; i < number_of_streams; i++)
+        {
+            if (streams[i].valid && (earliest == NULL || streams[i].record.time < earliest->record.time))
+            {
+                earliest = &streams[i];
+            }
+        }
+        if (earliest == NULL)
+        {
+            return;
+        }
+
+        if (earliest->record.op == 'S')
+        {
+            entry = _get_entry(earliest->record.cid, earliest->record.oid);
+            entry->hash = earliest->record.hash;
+        }
+        else if (earliest->record.op == 'D')
+        {
+            entry = _get_entry(earliest->record.cid, earliest->record.oid);
+            entry->hash = empty;
+        }
+        _next_record(earliest);
+    }
+}
 
 int main(int argc, char *argv[])
 {
-    int i = 0, j = 0, error = 0;
+    int i = 0, error = 0;
     int number_of_objects = 1024, max_size_of_objects = 8192, number_of_containers = 1;
-    int child_pid, cid, stat, devfd;
-    long size;
-    __u64 object_id, current_time;
-    char *data, op, *mapped_data;
-    char ***containers;
+    int number_of_streams, child_pid = 1, cid = 0, stat, devfd;
+    struct log_stream *streams;
+    struct object_entry *entry;
+    uint64_t expected, actual, empty = mcontainer_log_checksum("", 0);
+    char *mapped_data;
     pid_t *pid;
 
     // takes arguments from command line interface.
-    if (argc < 3)
+    if (argc < 4)
     {
-        fprintf(stderr, "Usage: %s number_of_objects max_size_of_objects number_of_containers\n", argv[0]);
+        fprintf(stderr, "Usage: %s number_of_objects max_size_of_objects number_of_containers [log files...]\n", argv[0]);
         exit(1);
     }
 
@@ -63,35 +409,28 @@ int main(int argc, char *argv[])
     max_size_of_objects = atoi(argv[2]);
     number_of_containers = atoi(argv[3]);
 
-    pid = (pid_t *) calloc(number_of_containers - 1, sizeof(pid_t));
-
-    // allocate memory spaces
-    data = (char *)malloc(max_size_of_objects * sizeof(char));
-    containers = (char ***)calloc(number_of_containers, sizeof(char **));
-
-    for (i = 0; i < number_of_containers; i++)
+    // Replay the logs to find the expected contents of the containers.
+    number_of_streams = argc > 4 ? argc - 4 : 1;
+    streams = (struct log_stream *)calloc(number_of_streams, sizeof(struct log_stream));
+    if (argc > 4)
     {
-        containers[i] = (char **)calloc(number_of_objects, sizeof(char *));
-        for (j = 0; j < number_of_objects; j++)
+        for (i = 0; i < number_of_streams; i++)
         {
-            containers[i][j] = (char *)malloc(max_size_of_objects * sizeof(char));
-            memset(containers[i][j], 0, max_size_of_objects);
+            _open_stream(&streams[i], argv[4 + i]);
         }
     }
-
-    // Replay the log to validate the results in containers.
-    while (scanf("%c %d %d %llu %llu %ld %s", &op, &child_pid, &cid, &current_time, &object_id, &size, &data[0]) != EOF)
+    else
     {
-        if (op == 'S')
-        {
-            strcpy(containers[cid][(int)object_id], data);
-            memset(data, 0, max_size_of_objects);
-        }
-        else if (op == 'D')
-        {
-            memset(containers[cid][(int)object_id], 0, max_size_of_objects);
-        }
+        streams[0].fp = stdin;
+        streams[0].binary = ungetc(getc(stdin), stdin) == (MCONTAINER_LOG_MAGIC & 0xff);
+        _next_record(&streams[0]);
     }
+    _replay(streams, number_of_streams);
+    for (i = 0; i < number_of_streams; i++)
+    {
+        _close_stream(&streams[i]);
+    }
+    free(streams);
 
     // open the container kernel module to check the results.
     devfd = open("/dev/mcontainer", O_RDWR);
@@ -101,29 +440,40 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    // parent process forks children to validate the results in containers.
-    for (i = 0; i < (number_of_containers - 1) && pid != 0; i++)
+    // process i validates container i
+    pid = (pid_t *) calloc(number_of_containers, sizeof(pid_t));
+    for (i = 1; i < number_of_containers; i++)
     {
         child_pid = fork();
         if (child_pid == 0)
         {
+            cid = i;
             break;
         }
-        else
-        {
-            pid[i] = child_pid;
-        }    
+        pid[i] = child_pid;
     }
 
-    cid = getpid() % number_of_containers;
     mcontainer_create(devfd, cid);
 
     for (i = 0; i < number_of_objects; i++)
     {
         mapped_data = (char *)mcontainer_alloc(devfd, i, max_size_of_objects);
-        if (strcmp(mapped_data, containers[cid][i]) != 0)
+        if (mapped_data == MAP_FAILED)
         {
-            fprintf(stderr, "Container %d Object %d has a wrong value %s v.s. %s\n", cid, i, mapped_data, containers[cid][i]);
+            fprintf(stderr, "Container %d Object %d cannot be mapped\n", cid, i);
+            error++;
+            continue;
+        }
+        actual = mcontainer_log_checksum(mapped_data, strnlen(mapped_data, max_size_of_objects));
+        // checked objects are freed, so a later run starts from an empty container
+        mcontainer_free(devfd, i);
+
+        entry = objects_size ? _find_entry(objects, objects_size, cid, i) : NULL;
+        expected = entry && entry->used ? entry->hash : empty;
+        if (actual != expected)
+        {
+            fprintf(stderr, "Container %d Object %d has a wrong value, hash %016llx v.s. %016llx\n",
+                    cid, i, (unsigned long long)actual, (unsigned long long)expected);
             error++;
         }
     }
@@ -135,27 +485,21 @@ int main(int argc, char *argv[])
     }
 
     mcontainer_delete(devfd);
-    
     close(devfd);
-    free(data);
-    for (i = 0; i < number_of_containers; i++)
-    {
-        for (j = 0; j < number_of_objects; j++)
-        {
-            free(containers[i][j]);
-        }
-        free(containers[i]);
-    }
-    free(containers);
+    free(objects);
 
     if (child_pid != 0)
     {
-        for (i = 0; i < (number_of_containers - 1); i++)
+        for (i = 1; i < number_of_containers; i++)
         {
-            waitpid(pid[i], &stat, 0);  
+            waitpid(pid[i], &stat, 0);
+            if (!WIFEXITED(stat) || WEXITSTATUS(stat) != 0)
+            {
+                error++;
+            }
         }
     }
 
-    // free(pid);
-    return 0;
+    free(pid);
+    return error ? 1 : 0;
 }
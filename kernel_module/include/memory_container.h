@@ -41,10 +41,110 @@ struct memory_container_cmd
     __u64 oid;
 };
 
+// a vector of commands for MCONTAINER_IOCTL_BATCH
+// 'op' of every entry is the ioctl number of the command to run:
+// MCONTAINER_IOCTL_CREATE, DELETE, LOCK, LOCK_SHARED, UNLOCK or FREE
+struct memory_container_batch
+{
+    __u64 count;
+    __u64 cmds;      // user pointer to 'count' struct memory_container_cmd
+    __u64 statuses;  // user pointer to 'count' __s64, status of each entry
+};
+
+#define MCONTAINER_BATCH_MAX 65536
+
+// a lock request for MCONTAINER_IOCTL_TIMEDLOCK
+struct memory_container_timedlock
+{
+    __u64 oid;
+    __u64 flags;       // MCONTAINER_LOCK_* flags
+    __u64 timeout_ns;  // 0 fails right away like MCONTAINER_IOCTL_TRYLOCK
+    __u64 reserved;    // must be 0
+};
+
+// arguments of MCONTAINER_IOCTL_CREATE_RESERVED
+struct memory_container_create
+{
+    __u64 cid;
+    __u64 flags;          // MCONTAINER_CREATE_* flags
+    __u64 reserve_bytes;  // memory set aside for the container's objects, rounded up to pages
+    __u64 reserved;       // must be 0
+};
+
+// buffer for MCONTAINER_IOCTL_LOCK_COLLECT
+struct memory_container_granted
+{
+    __u64 count;  // capacity of 'oids'
+    __u64 oids;   // user pointer to 'count' __u64, filled with oids of granted requests
+};
+
+// memory limit and usage of container 'cid', in bytes
+// objects are charged with their full size when they are created
+struct memory_container_usage
+{
+    __u64 cid;
+    __u64 limit;  // 0 if unlimited
+    __u64 usage;
+    __u64 peak;
+};
+
 #define MCONTAINER_IOCTL_DELETE _IOWR('N', 0x45, struct memory_container_cmd)
 #define MCONTAINER_IOCTL_CREATE _IOWR('N', 0x46, struct memory_container_cmd)
 #define MCONTAINER_IOCTL_LOCK _IOWR('N', 0x47, struct memory_container_cmd)
 #define MCONTAINER_IOCTL_UNLOCK _IOWR('N', 0x48, struct memory_container_cmd)
 #define MCONTAINER_IOCTL_FREE _IOWR('N', 0x49, struct memory_container_cmd)
+#define MCONTAINER_IOCTL_LOCK_WAIT _IOWR('N', 0x4a, struct memory_container_cmd)
+#define MCONTAINER_IOCTL_LOCK_WAKE _IOWR('N', 0x4b, struct memory_container_cmd)
+#define MCONTAINER_IOCTL_BATCH _IOWR('N', 0x4c, struct memory_container_batch)
+#define MCONTAINER_IOCTL_SET_LIMIT _IOWR('N', 0x4d, struct memory_container_usage)
+#define MCONTAINER_IOCTL_GET_USAGE _IOWR('N', 0x4e, struct memory_container_usage)
+// shared lock of an object, UNLOCK releases locks of either mode
+#define MCONTAINER_IOCTL_LOCK_SHARED _IOWR('N', 0x4f, struct memory_container_cmd)
+// locks without waiting, fails with EBUSY, MCONTAINER_LOCK_* flags are passed in 'op'
+#define MCONTAINER_IOCTL_TRYLOCK _IOWR('N', 0x50, struct memory_container_cmd)
+// locks waiting at most timeout_ns, fails with ETIMEDOUT or EINTR
+#define MCONTAINER_IOCTL_TIMEDLOCK _IOWR('N', 0x51, struct memory_container_timedlock)
+// requests a lock without blocking, MCONTAINER_LOCK_* flags are passed in 'op'
+// returns 0 if the lock was free, fails with EINPROGRESS if the request was queued
+// the device file polls readable once queued requests are granted
+#define MCONTAINER_IOCTL_LOCK_ASYNC _IOWR('N', 0x52, struct memory_container_cmd)
+// returns the number of granted requests written to 'oids', their locks are held
+#define MCONTAINER_IOCTL_LOCK_COLLECT _IOWR('N', 0x53, struct memory_container_granted)
+// withdraws a request, releasing the lock if it was granted but not collected
+#define MCONTAINER_IOCTL_LOCK_CANCEL _IOWR('N', 0x54, struct memory_container_cmd)
+// CREATE that also allocates a pool of 'reserve_bytes' when it creates the container
+// objects of the container only use pool pages, creating an object fails with 
+// ENOMEM once the rest of the pool cannot back it
+// pool pages are single pages, MCONTAINER_CREATE_HUGEPAGE does not apply to them
+#define MCONTAINER_IOCTL_CREATE_RESERVED _IOWR('N', 0x55, struct memory_container_create)
+
+// flags for MCONTAINER_IOCTL_TRYLOCK, TIMEDLOCK and LOCK_ASYNC
+#define MCONTAINER_LOCK_SHARED 0x1  // take the lock shared with other readers
+#define MCONTAINER_LOCK_FLAGS MCONTAINER_LOCK_SHARED
+
+// mmap offset, in pages, of the container's lock page
+// it holds MCONTAINER_LOCK_PAGE_SLOTS 32 bit lock words,
+// object oid uses word (oid % MCONTAINER_LOCK_PAGE_SLOTS)
+#define MCONTAINER_LOCK_PAGE_OID (1ULL << 40)
+#define MCONTAINER_LOCK_PAGE_SLOTS 1024
+
+// mmap offset, in pages, of an arena: one mapping over the objects
+// first_oid .. first_oid + count - 1, each in a slot of slot_pages pages
+// the mapping is count * slot_pages pages long, objects are created on first touch
+// FREE unmaps the object's slot, touching it again creates a new object
+#define MCONTAINER_ARENA_OID (1ULL << 41)
+#define MCONTAINER_ARENA_SLOT_SHIFT 32
+#define MCONTAINER_ARENA_SLOT_MAX 255  // pages per slot
+#define MCONTAINER_ARENA_FIRST_OID_MAX 0xffffffffULL
+#define MCONTAINER_ARENA_OFFSET(first_oid, slot_pages) \
+    (MCONTAINER_ARENA_OID | ((__u64)(slot_pages) << MCONTAINER_ARENA_SLOT_SHIFT) | (__u64)(first_oid))
+
+// flags for MCONTAINER_IOCTL_CREATE, passed in 'op'
+// they only apply when the call creates the container
+#define MCONTAINER_CREATE_CONTAINER_LOCK 0x1  // one lock for all objects instead of per object lock
+#define MCONTAINER_CREATE_HUGEPAGE 0x2        // back objects of 2 MiB and larger with huge pages
+#define MCONTAINER_CREATE_NUMA_LOCAL 0x4      // take the reserved pool from the caller's NUMA node only
+#define MCONTAINER_CREATE_FLAGS (MCONTAINER_CREATE_CONTAINER_LOCK | MCONTAINER_CREATE_HUGEPAGE | \
+        MCONTAINER_CREATE_NUMA_LOCAL)
 
 #endif
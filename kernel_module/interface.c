@@ -36,6 +36,7 @@
 #include <linux/kernel.h>
 #include <linux/errno.h>
 #include <linux/mm.h>
+#include <linux/huge_mm.h>
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -47,13 +48,22 @@ extern long memory_container_lock(struct memory_container_cmd __user *user_cmd);
 extern long memory_container_unlock(struct memory_container_cmd __user *user_cmd);
 extern long memory_container_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
 extern int memory_container_mmap(struct file *filp, struct vm_area_struct *vma);
+extern int memory_container_open(struct inode *inode, struct file *filp);
+extern int memory_container_release(struct inode *inode, struct file *filp);
+extern int memory_container_flush(struct file *filp, fl_owner_t id);
+extern __poll_t memory_container_poll(struct file *filp, poll_table *wait);
 extern int memory_container_init(void);
 extern void memory_container_exit(void);
 
 static const struct file_operations memory_container_fops = {
     .owner                = THIS_MODULE,
+    .open                 = memory_container_open,
+    .release              = memory_container_release,
+    .flush                = memory_container_flush,
+    .poll                 = memory_container_poll,
     .unlocked_ioctl       = memory_container_ioctl,
     .mmap                 = memory_container_mmap,
+    .get_unmapped_area    = thp_get_unmapped_area,
 };
 
 struct miscdevice memory_container_dev = {
@@ -45,15 +45,24 @@
 #include <linux/sched.h>
 
 extern struct miscdevice memory_container_dev;
+extern int _init_tables(void);
+extern void _clean_up(void);
 
 
 int memory_container_init(void)
 {
     int ret;
 
+    if ((ret = _init_tables()))
+    {
+        printk(KERN_ERR "Unable to initialize \"memory_container\" container tables\n");
+        return ret;
+    }
+
     if ((ret = misc_register(&memory_container_dev)))
     {
         printk(KERN_ERR "Unable to register \"memory_container\" misc device\n");
+        _clean_up();
         return ret;
     }
 
@@ -65,4 +74,5 @@ int memory_container_init(void)
 void memory_container_exit(void)
 {
     misc_deregister(&memory_container_dev);
+    _clean_up();
 }
@@ -38,6 +38,7 @@
 #include <linux/errno.h>
 #include <linux/mm.h>
 #include <linux/fs.h>
+#include <linux/fdtable.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
@@ -45,82 +46,517 @@
 #include <linux/mutex.h>
 #include <linux/sched.h>
 #include <linux/kthread.h>
+#include <linux/rhashtable.h>
+#include <linux/rcupdate.h>
+#include <linux/radix-tree.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <linux/huge_mm.h>
+#include <linux/percpu_counter.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/kref.h>
+#include <linux/llist.h>
+#include <linux/workqueue.h>
+#include <linux/shrinker.h>
+#include <linux/pagemap.h>
+
+#include "mcontainer_compat.h"
+
+#define CREATE_TRACE_POINTS
+#include "mcontainer_trace.h"
 
 // defines a task
+// all threads of a process share one node, keyed by tgid
 typedef struct task_node {
     __u64 id;
     struct task_struct *task_pointer;
+    struct container_node *container;  // container this task is bound to
     struct list_head task_list;
+    struct rhash_head t_node;  // links task into task table
+    struct rcu_head rcu;
 } TaskNode;
 
 // defines a memory object
+// backing pages are allocated one at a time on first touch
+// the object index and every VMA mapping the object hold a reference, 
+// the object is freed by object_free_work after the last one is dropped
 typedef struct mem_object_node {
+    struct container_node *container;  // referenced while the object exists
     __u64 offset;
-    unsigned long kmalloc_area;  // stores pointer to allocated memory area
-    struct list_head mem_objects_list;
+    unsigned long nr_pages;  // size of the object in pages
+    unsigned long capacity;  // entries in pages, a power of two for recyclable sizes
+    int huge;                // backed by huge page sized chunks where possible
+    struct page **pages;     // backing pages, NULL until faulted in
+    struct kref ref;
+    struct llist_node f_node;  // links object into object_free_list
+    struct list_head fl_node;  // links object into its container's free list
+    unsigned long fl_pages;    // resident pages kept while on a free list
 } ObjectNode;
 
+// defines an arena, a single mapping over a range of objects
+// shared by all VMAs split or copied from the original mapping
+typedef struct arena_node {
+    struct container_node *container;  // referenced while the arena exists
+    __u64 first_oid;
+    unsigned long pgoff;       // mmap offset the arena was created with
+    unsigned long slot_pages;  // pages per object
+    unsigned long nr_slots;
+    struct kref ref;           // one per VMA
+    struct address_space *mapping;  // of the device file, to zap freed slots
+    struct list_head a_node;   // links arena into its container's arenas
+} ArenaNode;
+
+#define STATS_HIST_BUCKETS 32
+
+// freed objects of up to 2^(OBJECT_CLASSES - 1) pages are kept for reuse,
+// one free list per log2 of their capacity
+#define OBJECT_CLASSES 16
+
+// per CPU statistics of a container, summed up when read through debugfs
+// histograms count lock wait and hold times in log2 nanosecond buckets
+typedef struct container_stats {
+    u64 mmap_hits;         // mmap of an existing object
+    u64 mmap_allocs;       // mmap which created a new object
+    u64 lock_acquisitions;
+    u64 objects_recycled;  // objects taken from a free list
+    s64 resident_pages;    // pages backing objects, may be negative on a single CPU
+    u64 lock_wait_hist[STATS_HIST_BUCKETS];
+    u64 lock_hold_hist[STATS_HIST_BUCKETS];
+} ContainerStats;
+
 // defines a container
-// contains list of tasks and list of allocated memory objects
+// contains list of tasks and an index of allocated memory objects
+// fields read on every call come first, fields written by object 
+// and task updates sit on cache lines of their own
+// references are held by the container table, objects, arenas, queued 
+// lock requests and calls in progress, tasks are counted in num_tasks
 typedef struct container_node {
     __u64 id;
-    int num_tasks;
+    __u64 flags;  // MCONTAINER_CREATE_* flags given at creation
+    struct radix_tree_root mem_objects;  // objects indexed by page offset
+    struct page *lock_page;  // lock words shared with user space, allocated on first mmap
+    struct rhash_head c_node;  // links container into container table
+    struct kref ref;
+    struct rcu_head rcu;
+
+    spinlock_t object_lock ____cacheline_aligned_in_smp;  // serializes updates to objects' index
     int num_objects;
-    TaskNode t_list;
-    ObjectNode mem_objects;
-    struct mutex mem_lock;   // local lock for operations on mem objects
-    struct mutex task_lock;  // local lock for operations on tasks' list
-    struct list_head c_list;
+
+    // bytes of objects charged to this container, summed lazily across CPUs
+    struct percpu_counter usage;
+    __u64 limit;  // 0 if unlimited
+    atomic64_t peak;
+
+    ContainerStats __percpu *stats;
+    struct dentry *debugfs_file;  // /sys/kernel/debug/mcontainer/<cid>
+
+    struct mutex arena_lock;  // protects arenas, held while freed objects are zapped
+    struct list_head arenas;  // arenas mapping objects of this container
+
+    spinlock_t free_lock ____cacheline_aligned_in_smp;  // protects free lists
+    struct list_head free_lists[OBJECT_CLASSES];  // freed objects with their zeroed pages
+    int free_counts[OBJECT_CLASSES];
+    unsigned long free_pages;  // resident pages of all objects on free lists
+
+    // pages reserved at creation, objects of a container with a pool
+    // take their pages from it instead of the page allocator
+    spinlock_t pool_lock ____cacheline_aligned_in_smp;  // protects pool
+    struct list_head pool;      // zeroed pages not backing any object, linked by page->lru
+    unsigned long pool_pages;   // size of the pool at creation, 0 without a pool
+    atomic_long_t pool_free;    // pool pages not promised to any object
+    int pool_node;              // NUMA node of the pool, NUMA_NO_NODE if any
+
+    struct mutex task_lock ____cacheline_aligned_in_smp;  // local lock for operations on tasks' list
+    int num_tasks;
+    struct list_head t_list;
+    int dead;                    // torn down, no task may join anymore
+    unsigned long idle_since;    // jiffies when the last task left
+    struct list_head idle_list;  // links container into idle_containers during its grace period
 } ContainerNode;
 
-// a global lock on list of containers
-static DEFINE_MUTEX(container_lock);
+// containers are indexed by id in a resizable hash table
+// lookups are RCU protected, inserts use the table's own bucket locks
+static const struct rhashtable_params container_table_params = {
+    .key_len = sizeof(__u64),
+    .key_offset = offsetof(ContainerNode, id),
+    .head_offset = offsetof(ContainerNode, c_node),
+    .automatic_shrinking = true,
+};
+
+static struct rhashtable container_table;
+
+// tasks are indexed by tgid, so that every call resolves
+// the caller's container without scanning all containers
+static const struct rhashtable_params task_table_params = {
+    .key_len = sizeof(__u64),
+    .key_offset = offsetof(TaskNode, id),
+    .head_offset = offsetof(TaskNode, t_node),
+    .automatic_shrinking = true,
+};
+
+static struct rhashtable task_table;
+
+// root of per container statistics files
+static struct dentry *debugfs_root;
+
+// slab caches of metadata nodes, visible in /proc/slabinfo
+static struct kmem_cache *container_cache;
+static struct kmem_cache *task_cache;
+static struct kmem_cache *object_cache;
+static struct kmem_cache *lock_cache;
+
+// containers without tasks keep their objects this long, 0 tears them down right away,
+// negative keeps them, see _set_container_grace_ms() for changes at run time
+static int container_grace_ms;
+
+// freed objects kept per size class of a container, 0 disables recycling
+static unsigned int free_list_cap = 32;
+module_param(free_list_cap, uint, 0644);
+MODULE_PARM_DESC(free_list_cap, "Freed objects a container keeps for reuse per size class");
+
+// memory a container keeps on all its free lists together, these pages are
+// not charged to the container and are given back by the shrinker under pressure
+static unsigned int free_list_max_kb = 16384;
+module_param(free_list_max_kb, uint, 0644);
+MODULE_PARM_DESC(free_list_max_kb, "Memory in KiB of freed objects a container keeps for reuse");
+
+// pages on the free lists of all containers
+static atomic_long_t free_list_pages = ATOMIC_LONG_INIT(0);
+
+// containers without tasks in their grace period, or kept, oldest first
+static LIST_HEAD(idle_containers);
+static DEFINE_MUTEX(idle_lock);
+
+// defines the lock of a single object
+// exists only while it is held or waited on, so the lock 
+// outlives FREE of the object it protects
+// held either by one writer or by any number of readers, tasks
+// that have to wait are queued and granted the lock in arrival order
+typedef struct lock_node {
+    ContainerNode *container;
+    __u64 oid;
+    int writer;   // 1 while a task holds the lock exclusively
+    int readers;  // tasks holding the lock shared
+    int refs;  // holders and waiters, node is freed when it drops to 0
+    u64 acquired_ns;  // when the current writer, or the first current reader, got the lock
+    struct list_head waiters;  // LockWaiters in arrival order
+    wait_queue_head_t wait;
+    struct hlist_node l_node;
+} LockNode;
+
+// state of an open device file
+// asynchronous lock requests belong to the file they were made through
+typedef struct file_node {
+    spinlock_t request_lock;    // protects requests, nr_granted and granted flags of requests
+    struct list_head requests;  // LockRequests, pending or granted
+    int nr_granted;             // granted requests not collected yet
+    wait_queue_head_t poll_wait;
+} FileNode;
+
+// a task or an asynchronous request waiting for a lock
+// waiters of tasks live on the waiting task's stack
+typedef struct lock_waiter {
+    struct list_head w_list;
+    int shared;
+    int granted;     // set once the lock has been handed over to the waiter
+    FileNode *file;  // file of an asynchronous request, NULL for a sleeping task
+} LockWaiter;
+
+// an asynchronous lock request, granted requests are reported by poll()
+typedef struct lock_request {
+    LockWaiter waiter;
+    ContainerNode *container;  // referenced while the request exists
+    struct lock_bucket *bucket;
+    LockNode *lock_node;
+    __u64 oid;  // object as requested
+    struct list_head r_list;  // links request into its file
+} LockRequest;
+
+// a bucket of the global object lock table
+typedef struct lock_bucket {
+    spinlock_t lock;
+    struct hlist_head chain;
+} LockBucket;
 
-// pointer to head of container list
-// similar to initializing a linked list
-struct list_head container_list_head = LIST_HEAD_INIT(container_list_head);
+#define LOCK_TABLE_BITS 10
+
+// oid used for every lock of a container created with MCONTAINER_CREATE_CONTAINER_LOCK
+#define CONTAINER_LOCK_OID (~0ULL)
+
+// object locks of all containers hashed by (container, oid)
+static LockBucket lock_table[1 << LOCK_TABLE_BITS];
+
+#define USER_LOCK_WAIT_BITS 8
+
+// cid recorded in ioctl events of a task in no container
+#define TRACE_NO_CID (~0ULL)
+
+// number of batch entries copied from user space at a time
+#define BATCH_CHUNK_SIZE 16
+
+// bytes a CPU may charge before folding its share into the shared usage count
+#define USAGE_BATCH (256 * PAGE_SIZE)
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+// objects of MCONTAINER_CREATE_HUGEPAGE containers are backed in chunks of one PMD
+#define OBJECT_HUGE_PAGES HPAGE_PMD_NR
+#define OBJECT_HUGE_ORDER HPAGE_PMD_ORDER
+#endif
+
+// tasks waiting on a contended lock word of a lock page, hashed by (container, slot)
+static wait_queue_head_t user_lock_wait_table[1 << USER_LOCK_WAIT_BITS];
 
 /**
- * Returns 'container id' in kernel mode from user mode struct
+ * Copies a command from user mode onto the caller's stack
+ * @param  cmd      Command in kernel mode
  * @param  user_cmd Command from user mode
- * @return          Container id as an llu
- */
-__u64 _get_container_id_in_kernel(struct memory_container_cmd __user *user_cmd) {
-    __u64 cid;
-    struct memory_container_cmd *buf = (struct memory_container_cmd*)kmalloc(sizeof(*user_cmd), GFP_KERNEL);
-    copy_from_user(buf, user_cmd, sizeof(*user_cmd));
-    cid = buf->cid;
-    kfree(buf);
-    return cid;
+ * @return          0 on success, -EFAULT if user_cmd cannot be read
+ */
+int _get_cmd_in_kernel(struct memory_container_cmd *cmd, struct memory_container_cmd __user *user_cmd) {
+    if (copy_from_user(cmd, user_cmd, sizeof(*cmd))) {
+        return -EFAULT;
+    }
+    return 0;
 }
 
 /**
- * Returns 'memory object offset' in kernel mode from user mode struct
- * @param  user_cmd Struct from user mode
- * @return          Memory object offset as an llu
+ * Destroys slab caches of metadata nodes
+ * Waits for nodes still queued for freeing after an RCU grace period
  */
-__u64 _get_memory_object_offset_in_kernel(struct memory_container_cmd __user *user_cmd) {
-    __u64 oid;
-    struct memory_container_cmd *buf = (struct memory_container_cmd*)kmalloc(sizeof(*user_cmd), GFP_KERNEL);
-    copy_from_user(buf, user_cmd, sizeof(*user_cmd));
-    oid = buf->oid;
-    kfree(buf);
-    return oid;
+void _destroy_caches(void) {
+    rcu_barrier();
+    kmem_cache_destroy(lock_cache);
+    kmem_cache_destroy(object_cache);
+    kmem_cache_destroy(task_cache);
+    kmem_cache_destroy(container_cache);
+}
+
+/**
+ * Creates slab caches of metadata nodes
+ * @return 0 on success, -ENOMEM otherwise
+ */
+int _init_caches(void) {
+    container_cache = KMEM_CACHE(container_node, SLAB_HWCACHE_ALIGN);
+    task_cache = KMEM_CACHE(task_node, SLAB_HWCACHE_ALIGN);
+    object_cache = KMEM_CACHE(mem_object_node, SLAB_HWCACHE_ALIGN);
+    lock_cache = KMEM_CACHE(lock_node, SLAB_HWCACHE_ALIGN);
+    if (container_cache == NULL || task_cache == NULL || object_cache == NULL || lock_cache == NULL) {
+        _destroy_caches();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+/**
+ * Frees a container node once no RCU reader can see it anymore
+ */
+void _free_container_rcu(struct rcu_head *rcu) {
+    kmem_cache_free(container_cache, container_of(rcu, ContainerNode, rcu));
+}
+
+/**
+ * Drops lock nodes left behind by tasks which never unlocked them
+ * Nobody waits on them, waiters hold a reference on the container
+ */
+void _drop_container_locks(ContainerNode *container) {
+    LockNode *lock_node;
+    struct hlist_node *next;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(lock_table); i++) {
+        spin_lock(&lock_table[i].lock);
+        hlist_for_each_entry_safe(lock_node, next, &lock_table[i].chain, l_node) {
+            if (lock_node->container == container) {
+                hlist_del(&lock_node->l_node);
+                kmem_cache_free(lock_cache, lock_node);
+            }
+        }
+        spin_unlock(&lock_table[i].lock);
+    }
+}
+
+/**
+ * Allocates the reserved pool of a new container
+ * With MCONTAINER_CREATE_NUMA_LOCAL all pages come from the caller's node
+ * Pages allocated before a failure are freed by _free_container_pool()
+ * @return 0 on success, -ENOMEM if not all pages could be allocated, -EINTR
+ */
+int _reserve_container_pool(ContainerNode *container, unsigned long nr_pages) {
+    gfp_t gfp = GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN;
+    struct page *page;
+    unsigned long i;
+
+    spin_lock_init(&container->pool_lock);
+    INIT_LIST_HEAD(&container->pool);
+    container->pool_pages = 0;
+    atomic_long_set(&container->pool_free, 0);
+    container->pool_node = NUMA_NO_NODE;
+    if (container->flags & MCONTAINER_CREATE_NUMA_LOCAL) {
+        container->pool_node = numa_node_id();
+        gfp |= __GFP_THISNODE;
+    }
+
+    for (i = 0; i < nr_pages; i++) {
+        page = alloc_pages_node(container->pool_node, gfp, 0);
+        if (page == NULL) {
+            return -ENOMEM;
+        }
+        list_add(&page->lru, &container->pool);
+        if (fatal_signal_pending(current)) {
+            return -EINTR;
+        }
+        cond_resched();
+    }
+    container->pool_pages = nr_pages;
+    atomic_long_set(&container->pool_free, nr_pages);
+    return 0;
+}
+
+/**
+ * Frees the pages of a container's pool, all objects must be gone
+ */
+void _free_container_pool(ContainerNode *container) {
+    struct page *page, *next;
+
+    list_for_each_entry_safe(page, next, &container->pool, lru) {
+        list_del(&page->lru);
+        __free_page(page);
+    }
+}
+
+/**
+ * Promises given number of pool pages to a new object
+ * @return true if the container has no pool or the pool can back the object
+ */
+bool _reserve_pool_pages(ContainerNode *container, unsigned long nr_pages) {
+    long free;
+
+    if (container->pool_pages == 0) {
+        return true;
+    }
+    free = atomic_long_read(&container->pool_free);
+    do {
+        if (free < (long)nr_pages) {
+            return false;
+        }
+    } while (!atomic_long_try_cmpxchg(&container->pool_free, &free, free - nr_pages));
+    return true;
+}
+
+/**
+ * Returns pages promised by _reserve_pool_pages() which were never taken
+ */
+void _unreserve_pool_pages(ContainerNode *container, unsigned long nr_pages) {
+    if (container->pool_pages != 0) {
+        atomic_long_add(nr_pages, &container->pool_free);
+    }
+}
+
+/**
+ * Takes a zeroed page from the pool of given container
+ * @return Page, NULL if the pool is empty
+ */
+void* _take_pool_page(ContainerNode *container) {
+    struct page *page;
+
+    spin_lock(&container->pool_lock);
+    page = list_first_entry_or_null(&container->pool, struct page, lru);
+    if (page != NULL) {
+        list_del(&page->lru);
+    }
+    spin_unlock(&container->pool_lock);
+    return page;
+}
+
+/**
+ * Puts a zeroed page back into the pool of given container
+ */
+void _put_pool_page(ContainerNode *container, struct page *page) {
+    spin_lock(&container->pool_lock);
+    list_add(&page->lru, &container->pool);
+    spin_unlock(&container->pool_lock);
+}
+
+/**
+ * Moves the pages of an object no task can see anymore back into the pool
+ * and releases the pages promised to it
+ * Pages still mapped through an arena are dropped, shrinking the pool
+ */
+void _return_pool_pages(ContainerNode *container, ObjectNode *object) {
+    struct page *page;
+    unsigned long i, lost = 0, returned = 0;
+    LIST_HEAD(pages);
+
+    for (i = 0; i < object->capacity; i++) {
+        page = object->pages[i];
+        if (page == NULL) {
+            continue;
+        }
+        object->pages[i] = NULL;
+        if (page_count(page) != 1) {
+            put_page(page);
+            lost++;
+        } else {
+            clear_highpage(page);
+            list_add(&page->lru, &pages);
+            returned++;
+        }
+    }
+    this_cpu_sub(container->stats->resident_pages, lost + returned);
+
+    spin_lock(&container->pool_lock);
+    list_splice(&pages, &container->pool);
+    spin_unlock(&container->pool_lock);
+    atomic_long_add(object->nr_pages - lost, &container->pool_free);
+}
+
+/**
+ * Frees a container after its last reference is dropped
+ * Its tasks and objects are already gone by then
+ */
+void _release_container(struct kref *ref) {
+    ContainerNode *container = container_of(ref, ContainerNode, ref);
+
+    _drop_container_locks(container);
+    // pages mapped by some task are freed once they are unmapped
+    if (container->lock_page != NULL) {
+        put_page(container->lock_page);
+    }
+    _free_container_pool(container);
+    free_percpu(container->stats);
+    percpu_counter_destroy(&container->usage);
+    call_rcu(&container->rcu, _free_container_rcu);
+}
+
+/**
+ * Drops a reference on given container
+ */
+void _put_container(ContainerNode *container) {
+    kref_put(&container->ref, _release_container);
 }
 
 /**
  * Returns container with given id
+ * The container is returned with a reference, dropped by _put_container()
  * @param cid Container id
+ * @return    Container Node, NULL if there is no container with that id
  */      
 void* _get_container(__u64 cid) {
-    struct list_head *c_pos, *c_q;
-    list_for_each_safe(c_pos, c_q, &container_list_head) {
-        ContainerNode *temp_container = list_entry(c_pos, ContainerNode, c_list);
-        if (temp_container->id == cid) {
-            return temp_container;
-        }
+    ContainerNode *container;
+
+    rcu_read_lock();
+    container = (ContainerNode*)rhashtable_lookup(&container_table, &cid, container_table_params);
+    if (container != NULL && !kref_get_unless_zero(&container->ref)) {
+        container = NULL;
     }
-    return NULL;
+    rcu_read_unlock();
+    return container;
 }
 
 /**
@@ -131,45 +567,215 @@ void* _get_container(__u64 cid) {
 int _container_exists(__u64 cid) {
     ContainerNode* container = (ContainerNode*)_get_container(cid);
     if(container != NULL) {
+        _put_container(container);
         return 1;
     }
     return 0;
 }
 
 /**
- * Adds new container with given container id to list of containers
- * @param cid Container Id
+ * Adds a duration to given log2 histogram
  */
-void _add_new_container(__u64 cid) {
-    ContainerNode *new_container;
-    new_container = (ContainerNode*)kmalloc(sizeof(ContainerNode), GFP_KERNEL);
+void _stats_hist_add(u64 *hist, u64 ns) {
+    hist[min_t(unsigned int, ilog2(ns | 1), STATS_HIST_BUCKETS - 1)]++;
+}
+
+/**
+ * Prints statistics of a container, summing counters of all CPUs
+ */
+int _stats_show(struct seq_file *m, void *v) {
+    ContainerNode *container = (ContainerNode*)m->private;
+    u64 mmap_hits = 0, mmap_allocs = 0, lock_acquisitions = 0, objects_recycled = 0;
+    u64 lock_wait_hist[STATS_HIST_BUCKETS] = { 0 }, lock_hold_hist[STATS_HIST_BUCKETS] = { 0 };
+    s64 resident_pages = 0;
+    int cpu, i;
+
+    for_each_possible_cpu(cpu) {
+        ContainerStats *stats = per_cpu_ptr(container->stats, cpu);
+        mmap_hits += stats->mmap_hits;
+        mmap_allocs += stats->mmap_allocs;
+        lock_acquisitions += stats->lock_acquisitions;
+        objects_recycled += stats->objects_recycled;
+        resident_pages += stats->resident_pages;
+        for (i = 0; i < STATS_HIST_BUCKETS; i++) {
+            lock_wait_hist[i] += stats->lock_wait_hist[i];
+            lock_hold_hist[i] += stats->lock_hold_hist[i];
+        }
+    }
+
+    seq_printf(m, "cid %llu\n", container->id);
+    seq_printf(m, "tasks %d\n", READ_ONCE(container->num_tasks));
+    seq_printf(m, "objects %d\n", READ_ONCE(container->num_objects));
+    seq_printf(m, "resident_bytes %lld\n", max_t(s64, resident_pages, 0) << PAGE_SHIFT);
+    seq_printf(m, "charged_bytes %lld\n", percpu_counter_sum_positive(&container->usage));
+    seq_printf(m, "limit_bytes %llu\n", READ_ONCE(container->limit));
+    seq_printf(m, "mmap_hits %llu\n", mmap_hits);
+    seq_printf(m, "mmap_allocs %llu\n", mmap_allocs);
+    seq_printf(m, "lock_acquisitions %llu\n", lock_acquisitions);
+    seq_printf(m, "objects_recycled %llu\n", objects_recycled);
+    seq_printf(m, "free_list_cap %u\n", READ_ONCE(free_list_cap));
+    seq_printf(m, "free_list_max_bytes %llu\n", (u64)READ_ONCE(free_list_max_kb) << 10);
+    // class i holds objects of 2^i pages capacity
+    seq_puts(m, "free_list_objects_log2");
+    for (i = 0; i < OBJECT_CLASSES; i++) {
+        seq_printf(m, " %d", READ_ONCE(container->free_counts[i]));
+    }
+    seq_printf(m, "\nfree_list_bytes %llu\n", (u64)READ_ONCE(container->free_pages) << PAGE_SHIFT);
+    seq_printf(m, "pool_bytes %lu\n", container->pool_pages << PAGE_SHIFT);
+    seq_printf(m, "pool_free_bytes %ld\n", atomic_long_read(&container->pool_free) << PAGE_SHIFT);
+    seq_printf(m, "pool_node %d\n", container->pool_node);
+    // bucket i counts durations in [2^i, 2^(i+1)) ns
+    seq_puts(m, "lock_wait_ns_log2");
+    for (i = 0; i < STATS_HIST_BUCKETS; i++) {
+        seq_printf(m, " %llu", lock_wait_hist[i]);
+    }
+    seq_puts(m, "\nlock_hold_ns_log2");
+    for (i = 0; i < STATS_HIST_BUCKETS; i++) {
+        seq_printf(m, " %llu", lock_hold_hist[i]);
+    }
+    seq_puts(m, "\n");
+    return 0;
+}
+
+int _stats_open(struct inode *inode, struct file *file) {
+    return single_open(file, _stats_show, inode->i_private);
+}
+
+static const struct file_operations stats_fops = {
+    .owner = THIS_MODULE,
+    .open = _stats_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/**
+ * Creates the statistics file of given container
+ * Statistics are best effort, the container works without the file
+ */
+void _create_stats_file(ContainerNode *container) {
+    char name[24];
+
+    container->debugfs_file = NULL;
+    if (IS_ERR_OR_NULL(debugfs_root)) {
+        return;
+    }
+    snprintf(name, sizeof(name), "%llu", container->id);
+    container->debugfs_file = debugfs_create_file(name, 0444, debugfs_root, container, &stats_fops);
+}
+
+/**
+ * Adds new container with given container id to container table
+ * If another task inserted the same id concurrently, the new node
+ * is dropped and the existing container is kept
+ * @param cid           Container Id
+ * @param flags         MCONTAINER_CREATE_* flags
+ * @param reserve_pages Size of the container's pool, 0 for none
+ * @return              0 on success, negative error code otherwise
+ */
+int _add_new_container(__u64 cid, __u64 flags, unsigned long reserve_pages) {
+    ContainerNode *new_container, *existing_container;
+    int i, ret;
+    new_container = (ContainerNode*)kmem_cache_alloc(container_cache, GFP_KERNEL);
+    if (new_container == NULL) {
+        return -ENOMEM;
+    }
     new_container->id = cid;
+    new_container->flags = flags;
+    new_container->lock_page = NULL;
     new_container->num_tasks = 0;
+    new_container->num_objects = 0;
+    new_container->dead = 0;
+    INIT_LIST_HEAD(&new_container->idle_list);
+    kref_init(&new_container->ref);  // owned by the container table
+    new_container->limit = 0;
+    atomic64_set(&new_container->peak, 0);
+    if (percpu_counter_init(&new_container->usage, 0, GFP_KERNEL)) {
+        kmem_cache_free(container_cache, new_container);
+        return -ENOMEM;
+    }
+    new_container->stats = alloc_percpu(ContainerStats);
+    if (new_container->stats == NULL) {
+        percpu_counter_destroy(&new_container->usage);
+        kmem_cache_free(container_cache, new_container);
+        return -ENOMEM;
+    }
     // initialize task list and lock 
     mutex_init(&new_container->task_lock);
-    INIT_LIST_HEAD(&((new_container->t_list).task_list));
-    // initialize memory objects' list and lock
-    mutex_init(&new_container->mem_lock);
-    INIT_LIST_HEAD(&((new_container->mem_objects).mem_objects_list));
-    // add new container to the container list
-    list_add(&(new_container->c_list), &container_list_head);
+    INIT_LIST_HEAD(&new_container->t_list);
+    // initialize memory objects' index and lock
+    spin_lock_init(&new_container->object_lock);
+    INIT_RADIX_TREE(&new_container->mem_objects, GFP_ATOMIC);
+    // arenas and their lock
+    mutex_init(&new_container->arena_lock);
+    INIT_LIST_HEAD(&new_container->arenas);
+    // free lists of recycled objects
+    spin_lock_init(&new_container->free_lock);
+    for (i = 0; i < OBJECT_CLASSES; i++) {
+        INIT_LIST_HEAD(&new_container->free_lists[i]);
+        new_container->free_counts[i] = 0;
+    }
+    new_container->free_pages = 0;
+    // the pool is filled before anyone can see the container
+    ret = _reserve_container_pool(new_container, reserve_pages);
+    if (ret) {
+        _free_container_pool(new_container);
+        free_percpu(new_container->stats);
+        percpu_counter_destroy(&new_container->usage);
+        kmem_cache_free(container_cache, new_container);
+        return ret;
+    }
+    // insert unless a container with same id is already present
+    existing_container = (ContainerNode*)rhashtable_lookup_get_insert_fast(&container_table, 
+            &new_container->c_node, container_table_params);
+    if (existing_container != NULL) {
+        _free_container_pool(new_container);
+        free_percpu(new_container->stats);
+        percpu_counter_destroy(&new_container->usage);
+        kmem_cache_free(container_cache, new_container);
+        if (IS_ERR(existing_container)) {
+            return PTR_ERR(existing_container);
+        }
+        return 0;
+    }
+    _create_stats_file(new_container);
+    return 0;
 }
 
 /**
- * Registers given container in container list
+ * Registers given container in container table
  * Checks whether given container already exists, 
- * if not, creates a new container & adds it to list
- * @param cid Container Id
+ * if not, creates a new container & adds it to table
+ * Flags and reservation only take effect for a newly created container
+ * @param cid           Container Id
+ * @param flags         MCONTAINER_CREATE_* flags
+ * @param reserve_pages Size of the container's pool, 0 for none
+ * @return              0 on success, negative error code otherwise
  */
-void _register_container(__u64 cid) {    
+int _register_container(__u64 cid, __u64 flags, unsigned long reserve_pages) {    
     // Do not create new container if it exists already
     if (_container_exists(cid)) {
-        return;
+        return 0;
     }    
 
-    mutex_lock(&container_lock);
-    _add_new_container(cid);
-    mutex_unlock(&container_lock);
+    return _add_new_container(cid, flags, reserve_pages);
+}
+
+/**
+ * Frees a task node once no RCU reader can see it anymore
+ */
+void _free_task_rcu(struct rcu_head *rcu) {
+    kmem_cache_free(task_cache, container_of(rcu, TaskNode, rcu));
+}
+
+/**
+ * Returns the task node bound to given thread group
+ * Must be called inside an RCU read side section
+ * @param  tgid Thread group id of the task
+ * @return      Task Node, NULL if task is not in any container
+ */
+void* _get_task(__u64 tgid) {
+    return rhashtable_lookup(&task_table, &tgid, task_table_params);
 }
 
 /**
@@ -179,286 +785,2195 @@ void _register_container(__u64 cid) {
  * @return     1 if exists, 0 if does not exist
  */
 int _task_exists(__u64 cid, __u64 tid) {
-    struct list_head *t_pos, *t_q;
-    ContainerNode *temp_container = (ContainerNode*)_get_container(cid);
+    TaskNode *temp_task;
+    int exists = 0;
 
-    if (temp_container != NULL) {
-        list_for_each_safe(t_pos, t_q, &(temp_container->t_list).task_list) {
-            TaskNode *temp_task = list_entry(t_pos, TaskNode, task_list);
-            if (temp_task->id == tid) {
-                return 1;
-            }
-        }
+    rcu_read_lock();
+    temp_task = (TaskNode*)_get_task(tid);
+    if (temp_task != NULL && temp_task->container->id == cid) {
+        exists = 1;
     }
-    return 0;
+    rcu_read_unlock();
+    return exists;
 }
 
 /**
  * Adds new task to given container
+ * The whole thread group shares one binding, keyed by its tgid
  * @param cid Container id 
  * @param tid task id
+ * @return    0 on success, -EAGAIN if the container is being torn down,
+ *            negative error code otherwise
  */
-void _add_new_task(__u64 cid, struct task_struct *task_ptr) {
-    TaskNode *new_task_node;
+int _add_new_task(__u64 cid, struct task_struct *task_ptr) {
+    TaskNode *new_task_node, *existing_task;
     ContainerNode *new_container;
+    int ret = 0;
 
     new_container = (ContainerNode*)_get_container(cid);
     
-    if (new_container != NULL) {
-        new_task_node = (TaskNode*)kmalloc(sizeof(TaskNode), GFP_KERNEL);
-        new_task_node->id = task_ptr->pid;
-        new_task_node->task_pointer = task_ptr;
-        list_add_tail(&(new_task_node->task_list), &((new_container->t_list).task_list));
+    if (new_container == NULL) {
+        return -ENOENT;
+    }
+
+    new_task_node = (TaskNode*)kmem_cache_alloc(task_cache, GFP_KERNEL);
+    if (new_task_node == NULL) {
+        _put_container(new_container);
+        return -ENOMEM;
+    }
+    new_task_node->id = task_ptr->tgid;
+    new_task_node->task_pointer = task_ptr->group_leader;
+    new_task_node->container = new_container;
+
+    // a container being torn down cannot be joined, the caller creates a new one
+    mutex_lock(&new_container->task_lock);
+    if (new_container->dead) {
+        mutex_unlock(&new_container->task_lock);
+        kmem_cache_free(task_cache, new_task_node);
+        _put_container(new_container);
+        return -EAGAIN;
+    }
+
+    // another thread of the same process may have bound it concurrently
+    existing_task = (TaskNode*)rhashtable_lookup_get_insert_fast(&task_table, 
+            &new_task_node->t_node, task_table_params);
+    if (existing_task != NULL) {
+        kmem_cache_free(task_cache, new_task_node);
+        ret = IS_ERR(existing_task) ? PTR_ERR(existing_task) : 0;
+    } else {
+        list_add_tail(&(new_task_node->task_list), &new_container->t_list);
         new_container->num_tasks = new_container->num_tasks + 1;    
+        // a task joining during the grace period keeps the container
+        if (new_container->num_tasks == 1) {
+            mutex_lock(&idle_lock);
+            list_del_init(&new_container->idle_list);
+            mutex_unlock(&idle_lock);
+        }
     }
+    mutex_unlock(&new_container->task_lock);
+    _put_container(new_container);
+    return ret;
 }
 
 /**
  * Finds the container node which contains given task
- * @param  tid Task id
+ * The container is returned with a reference, dropped by _put_container()
+ * @param  tid Task id, threads are looked up by their tgid
  * @return     Container Node
  */
 void* _find_container_containing_task(pid_t tid) {
-    ContainerNode *temp_container;
-    struct list_head *c_pos, *c_q, *t_pos, *t_q;
-
-    list_for_each_safe(c_pos, c_q, &container_list_head){
-        temp_container = list_entry(c_pos, ContainerNode, c_list);
-        list_for_each_safe(t_pos, t_q, &(temp_container->t_list).task_list) {
-            TaskNode *temp_task = list_entry(t_pos, TaskNode, task_list);
-            if (temp_task->id == tid) {
-                return temp_container;
-            }
-        }
+    TaskNode *temp_task;
+    ContainerNode *found_container = NULL;
+
+    rcu_read_lock();
+    temp_task = (TaskNode*)_get_task(tid);
+    if (temp_task != NULL && kref_get_unless_zero(&temp_task->container->ref)) {
+        found_container = temp_task->container;
     }
-    return NULL;
+    rcu_read_unlock();
+    return found_container;
 }
 
 /**
- * Associates given task with given container
- * Checks whether given task already exists in given container, 
- * if not, creates a new entry for given task in the container
- * @param cid Container id 
- * @param tid Task id
+ * Checks whether memory object is already allocated and return the object if present already
+ * Lookup is lockless, objects are only freed after an RCU grace period
+ * The object is returned with a reference, dropped by _put_memory_object()
+ * @param  container Container holding the object
+ * @param  offset    Offset of memory object
+ * @return           mem_object if exists, NULL if does not exist
  */
-void _register_task(__u64 cid, struct task_struct *task_ptr) {
-    ContainerNode *container;
-    // Do not add new task if it already exists
-    if (_task_exists(cid, task_ptr->pid)) {
-        return;
-    }
-
-    container = (ContainerNode*)_get_container(cid);
+void* _get_memory_object(ContainerNode *container, __u64 offset) {
+    ObjectNode *temp_object;
 
-    if (container != NULL) {
-        mutex_lock(&container->task_lock);
-        _add_new_task(cid, task_ptr);
-        mutex_unlock(&container->task_lock);
+    rcu_read_lock();
+    temp_object = (ObjectNode*)radix_tree_lookup(&container->mem_objects, offset);
+    // an object whose last reference is gone is on its way to be freed
+    if (temp_object != NULL && !kref_get_unless_zero(&temp_object->ref)) {
+        temp_object = NULL;
     }
+    rcu_read_unlock();
+    return temp_object;
 }
 
 /**
- * Removes task from given container
+ * Checks whether given object is still in its container's index
+ * Mappings keep an object alive after FREE, but it is no longer 
+ * charged to the container from then on
+ * @return true if the object was not freed
  */
-void _deregister_task_from_container(pid_t tid) {
-    ContainerNode *temp_container;
-    struct list_head *c_pos, *c_q, *t_pos, *t_q;
-
-    list_for_each_safe(c_pos, c_q, &container_list_head){
-        temp_container = list_entry(c_pos, ContainerNode, c_list);
-        list_for_each_safe(t_pos, t_q, &(temp_container->t_list).task_list) {
-            TaskNode *temp_task = list_entry(t_pos, TaskNode, task_list);
-            if (temp_task->id == tid) {
-                temp_container->num_tasks = temp_container->num_tasks - 1;
-                list_del(t_pos);
-                kfree(temp_task);
-            }
-        }
-    }
+bool _object_is_indexed(ObjectNode *object) {
+    bool indexed;
+
+    rcu_read_lock();
+    indexed = radix_tree_lookup(&object->container->mem_objects, object->offset) == object;
+    rcu_read_unlock();
+    return indexed;
 }
 
 /**
- * Checks whether memory object is already allocated and return the object if present already
- * @param  cid Container Id
- * @return     mem_object if exists, -1 if does not exist
+ * Charges given number of bytes to given container
+ * Usage is added first and rolled back when it ends up over the limit,
+ * so concurrent charges can never jointly exceed it, the exact sum 
+ * is only computed when usage gets within a batch of the limit
+ * @return 0 on success, -ENOMEM if container would go over its limit
  */
-void* _get_memory_object(__u64 offset) {
-    struct list_head *o_pos, *o_q;
-    ContainerNode *temp_container = (ContainerNode*)_find_container_containing_task(current->pid);
+int _charge_container(ContainerNode *container, __u64 bytes) {
+    __u64 limit = READ_ONCE(container->limit);
+    s64 usage, peak;
 
-    if (temp_container != NULL) {
-        list_for_each_safe(o_pos, o_q, &(temp_container->mem_objects).mem_objects_list) {
-            ObjectNode *temp_object = list_entry(o_pos, ObjectNode, mem_objects_list);
-            if (temp_object->offset == offset) {
-                return temp_object;
-            }
+    percpu_counter_add_batch(&container->usage, bytes, USAGE_BATCH);
+    if (limit != 0 && __percpu_counter_compare(&container->usage, limit, USAGE_BATCH) > 0) {
+        percpu_counter_add_batch(&container->usage, -(s64)bytes, USAGE_BATCH);
+        return -ENOMEM;
+    }
+
+    // peak is tracked from the approximate count, within a batch per CPU
+    usage = percpu_counter_read_positive(&container->usage);
+    peak = atomic64_read(&container->peak);
+    while (usage > peak) {
+        s64 old_peak = atomic64_cmpxchg(&container->peak, peak, usage);
+        if (old_peak == peak) {
+            break;
         }
+        peak = old_peak;
     }
-    return NULL;
+    return 0;
 }
 
 /**
- * Adds new object in object list of container
- * @param  cid    Container Id
- * @param  offset Offset of memory object
- * @return       
+ * Returns given number of bytes to given container
  */
-void _add_new_memory_object(__u64 offset, unsigned long kmalloc_area) {
-    ObjectNode *new_object_node;
-    ContainerNode *temp_container = (ContainerNode*)_find_container_containing_task(current->pid);
-    
-    if (temp_container != NULL) {
-        new_object_node = (ObjectNode*)kmalloc(sizeof(ObjectNode), GFP_KERNEL);
-        new_object_node->offset = offset;
-        new_object_node->kmalloc_area = kmalloc_area;
-        list_add_tail(&(new_object_node->mem_objects_list), &((temp_container->mem_objects).mem_objects_list));
-        temp_container->num_objects = temp_container->num_objects + 1;    
-    }
+void _uncharge_container(ContainerNode *container, __u64 bytes) {
+    percpu_counter_add_batch(&container->usage, -(s64)bytes, USAGE_BATCH);
 }
 
 /**
- * Removes object with given offset from list of objects of associated container
- * @param  cid    Container Id
- * @param  offset Offset of memory object
- * @return       
+ * Returns size class of objects with given number of pages
+ * Objects of class OBJECT_CLASSES and up are never recycled
  */
-void _remove_memory_object(__u64 offset) {
-    ContainerNode *temp_container;
-    struct list_head *t_pos, *t_q;
+int _object_class(unsigned long nr_pages) {
+    return order_base_2(nr_pages);
+}
 
-    temp_container = (ContainerNode*)_find_container_containing_task(current->pid);
+/**
+ * Drops the object's references on its backing pages
+ * Only called once no VMA maps the object, pfn mappings hold no
+ * page references of their own
+ */
+void _release_object_pages(ObjectNode *object) {
+    unsigned long i, released = 0;
 
-    if (temp_container != NULL) {
-        list_for_each_safe(t_pos, t_q, &(temp_container->mem_objects).mem_objects_list) {
-            ObjectNode *temp_object = list_entry(t_pos, ObjectNode, mem_objects_list);
-            if (temp_object->offset == offset) {
-                temp_container->num_objects = temp_container->num_objects - 1;
-                list_del(t_pos);
-                kfree((void*)temp_object->kmalloc_area);    // free the memory area which was allocated
-                kfree(temp_object);
-            }
+    for (i = 0; i < object->capacity; i++) {
+        if (object->pages[i] != NULL) {
+            put_page(object->pages[i]);
+            released++;
         }
     }
+    this_cpu_sub(object->container->stats->resident_pages, released);
+    kvfree(object->pages);
 }
 
 /**
- * Cleans up all data structures
+ * Frees an object node no task can see anymore along with its pages
  */
-void _clean_up(void) {
-    ContainerNode *temp_container;
-    struct list_head *c_pos, *c_q, *t_pos, *t_q, *o_pos, *o_q;
+void _free_object_node(ObjectNode *object) {
+    _release_object_pages(object);
+    kmem_cache_free(object_cache, object);
+}
+
+/**
+ * Checks whether given container's free lists have room for an object
+ * with given number of resident pages
+ * Must be called with the free lock held, or as a hint without it
+ */
+bool _free_lists_have_room(ContainerNode *container, int class, unsigned long nr_pages) {
+    unsigned long max_pages = (unsigned long)READ_ONCE(free_list_max_kb) >> (PAGE_SHIFT - 10);
 
-    list_for_each_safe(c_pos, c_q, &container_list_head){
-        temp_container = list_entry(c_pos, ContainerNode, c_list);
-        list_for_each_safe(t_pos, t_q, &(temp_container->t_list).task_list) {
-            TaskNode *temp_task = list_entry(t_pos, TaskNode, task_list);
-            list_del(t_pos);
-            kfree(temp_task);
+    return READ_ONCE(container->free_counts[class]) < READ_ONCE(free_list_cap) &&
+            READ_ONCE(container->free_pages) + nr_pages <= max_pages;
+}
+
+/**
+ * Keeps an object no task can see anymore on its container's free list
+ * Resident pages are zeroed and stay with the object, pages still mapped 
+ * through an arena are dropped
+ * @return true if the object was kept, false if it has to be freed
+ */
+bool _recycle_object(ContainerNode *container, ObjectNode *object) {
+    int class = _object_class(object->capacity);
+    unsigned long i, released = 0, kept = 0;
+
+    if (class >= OBJECT_CLASSES || !_free_lists_have_room(container, class, 0)) {
+        return false;
+    }
+    for (i = 0; i < object->capacity; i++) {
+        struct page *page = object->pages[i];
+        if (page == NULL) {
+            continue;
         }
-        list_for_each_safe(o_pos, o_q, &(temp_container->mem_objects).mem_objects_list) {
-            ObjectNode *temp_object = list_entry(o_pos, ObjectNode, mem_objects_list);
-            list_del(o_pos);
-            kfree(temp_object);
+        if (page_count(page) != 1) {
+            put_page(page);
+            object->pages[i] = NULL;
+            released++;
+        } else {
+            clear_highpage(page);
+            kept++;
         }
-        list_del(c_pos);
-        kfree(temp_container);
     }
-}
+    this_cpu_sub(container->stats->resident_pages, released);
 
-int memory_container_mmap(struct file *filp, struct vm_area_struct *vma)
-{
-    int ret;
-    char *kmalloc_ptr;
-    ObjectNode* existing_object;
-    unsigned long pfn, kmalloc_area;
+    spin_lock(&container->free_lock);
+    // free lists of a dead container were drained for good
+    if (container->dead || !_free_lists_have_room(container, class, kept)) {
+        spin_unlock(&container->free_lock);
+        return false;
+    }
+    list_add(&object->fl_node, &container->free_lists[class]);
+    container->free_counts[class] = container->free_counts[class] + 1;
+    object->fl_pages = kept;
+    container->free_pages = container->free_pages + kept;
+    spin_unlock(&container->free_lock);
+    atomic_long_add(kept, &free_list_pages);
+    return true;
+}
 
-    // find out page offset of the current memory object 
-    __u64 offset = vma->vm_pgoff;
-    // calculate total memory required
-    unsigned long total_memory = vma->vm_end - vma->vm_start;
+/**
+ * Takes the most recently freed object fitting given size from the free lists
+ * @return Object node with zeroed pages, NULL if there is none
+ */
+void* _take_recycled_object(ContainerNode *container, unsigned long nr_pages) {
+    int class = _object_class(nr_pages);
+    ObjectNode *object;
 
-    // update flags
-    vma->vm_private_data = filp->private_data;
+    if (class >= OBJECT_CLASSES || READ_ONCE(container->free_counts[class]) == 0) {
+        return NULL;
+    }
+    spin_lock(&container->free_lock);
+    object = list_first_entry_or_null(&container->free_lists[class], ObjectNode, fl_node);
+    if (object != NULL) {
+        list_del(&object->fl_node);
+        container->free_counts[class] = container->free_counts[class] - 1;
+        container->free_pages = container->free_pages - object->fl_pages;
+    }
+    spin_unlock(&container->free_lock);
 
-    // try to find a memory object with same offset    
-    existing_object = (ObjectNode*)_get_memory_object(offset);
+    if (object != NULL) {
+        atomic_long_sub(object->fl_pages, &free_list_pages);
+        this_cpu_inc(container->stats->objects_recycled);
+    }
+    return object;
+}
 
-    ContainerNode* container = (ContainerNode*)_find_container_containing_task(current->pid);
-    __u64 cid = 0;
-    if (container != NULL) cid = container->id;
+/**
+ * Frees objects from the free lists of given container, oldest of the
+ * largest class first, until given number of resident pages is freed
+ * @return Number of resident pages freed
+ */
+unsigned long _shrink_free_lists(ContainerNode *container, unsigned long nr_pages) {
+    ObjectNode *object, *next;
+    unsigned long freed = 0;
+    LIST_HEAD(shrunk);
+    int i;
 
-    // check if memory object already exists and is allocated 
-    if (existing_object != NULL) {
-        // use existing memory area, if object with same offset is found
-        kmalloc_area = existing_object->kmalloc_area;
+    spin_lock(&container->free_lock);
+    for (i = OBJECT_CLASSES - 1; i >= 0 && freed < nr_pages; i--) {
+        while (freed < nr_pages && !list_empty(&container->free_lists[i])) {
+            object = list_last_entry(&container->free_lists[i], ObjectNode, fl_node);
+            list_move(&object->fl_node, &shrunk);
+            container->free_counts[i] = container->free_counts[i] - 1;
+            freed += object->fl_pages;
+        }
+    }
+    container->free_pages = container->free_pages - freed;
+    spin_unlock(&container->free_lock);
+    atomic_long_sub(freed, &free_list_pages);
+
+    list_for_each_entry_safe(object, next, &shrunk, fl_node) {
+        _free_object_node(object);
+    }
+    return freed;
+}
+
+/**
+ * Frees all objects on the free lists of a dead container
+ */
+void _drain_free_lists(ContainerNode *container) {
+    _shrink_free_lists(container, ULONG_MAX);
+}
+
+/**
+ * Reports pages on the free lists of all containers to the shrinker
+ */
+unsigned long _free_lists_count(struct shrinker *shrinker, struct shrink_control *sc) {
+    long pages = atomic_long_read(&free_list_pages);
+
+    return pages > 0 ? pages : SHRINK_EMPTY;
+}
+
+/**
+ * Gives pages on free lists back under memory pressure
+ * Containers are walked in table order, the walk is paused while
+ * a container's objects are freed
+ */
+unsigned long _free_lists_scan(struct shrinker *shrinker, struct shrink_control *sc) {
+    struct rhashtable_iter iter;
+    ContainerNode *container;
+    unsigned long freed = 0;
+
+    rhashtable_walk_enter(&container_table, &iter);
+    rhashtable_walk_start(&iter);
+    while (freed < sc->nr_to_scan && (container = (ContainerNode*)rhashtable_walk_next(&iter)) != NULL) {
+        // the table was resized, the walk goes on from its start
+        if (IS_ERR(container) || !kref_get_unless_zero(&container->ref)) {
+            continue;
+        }
+        rhashtable_walk_stop(&iter);
+        freed += _shrink_free_lists(container, sc->nr_to_scan - freed);
+        _put_container(container);
+        rhashtable_walk_start(&iter);
+    }
+    rhashtable_walk_stop(&iter);
+    rhashtable_walk_exit(&iter);
+    return freed > 0 ? freed : SHRINK_STOP;
+}
+
+static struct shrinker *free_list_shrinker;
+
+/**
+ * Puts an object no task can see on its free list, or frees it if that is full
+ * Objects of a container with a pool give back the pages promised to them
+ */
+void _discard_object_node(ContainerNode *container, ObjectNode *object) {
+    // pages of a pool stay in the pool, the node alone is recycled
+    if (container->pool_pages != 0) {
+        _return_pool_pages(container, object);
+    }
+    if (!_recycle_object(container, object)) {
+        _free_object_node(object);
+    }
+}
+
+/**
+ * Adds new object in object index of container
+ * No memory is allocated for the object, pages are added on first touch
+ * The full size of the object is charged to the container up front
+ * If an object with same offset was added concurrently, 
+ * that object is returned and nothing is added
+ * The object is returned with a reference, like from _get_memory_object()
+ * Every object holds a reference on its container
+ * In a container with a pool, the object's pages are promised to it here
+ * @param  container Container holding the object
+ * @param  offset    Offset of memory object
+ * @param  nr_pages  Size of memory object in pages
+ * @return           Object stored at offset, ERR_PTR(-ENOMEM) if out of 
+ *                   memory, pool or over the container's limit, ERR_PTR(-EINVAL)
+ *                   if the container was torn down
+ */
+void* _add_new_memory_object(ContainerNode *container, __u64 offset, unsigned long nr_pages) {
+    ObjectNode *new_object_node, *existing_object;
+    int ret;
+
+    if (_charge_container(container, (__u64)nr_pages << PAGE_SHIFT)) {
+        return ERR_PTR(-ENOMEM);
+    }
+    // pages of a container with a pool are promised up front, faults cannot run out
+    if (!_reserve_pool_pages(container, nr_pages)) {
+        _uncharge_container(container, (__u64)nr_pages << PAGE_SHIFT);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    // a recycled object comes with its zeroed pages already resident
+    new_object_node = (ObjectNode*)_take_recycled_object(container, nr_pages);
+    if (new_object_node == NULL) {
+        new_object_node = (ObjectNode*)kmem_cache_alloc(object_cache, GFP_KERNEL);
+        if (new_object_node == NULL) {
+            _unreserve_pool_pages(container, nr_pages);
+            _uncharge_container(container, (__u64)nr_pages << PAGE_SHIFT);
+            return ERR_PTR(-ENOMEM);
+        }
+        new_object_node->capacity = nr_pages;
+        if (_object_class(nr_pages) < OBJECT_CLASSES) {
+            new_object_node->capacity = roundup_pow_of_two(nr_pages);
+        }
+        new_object_node->pages = (struct page**)kvmalloc_array(new_object_node->capacity, 
+                sizeof(struct page*), GFP_KERNEL | __GFP_ZERO);
+        if (new_object_node->pages == NULL) {
+            kmem_cache_free(object_cache, new_object_node);
+            _unreserve_pool_pages(container, nr_pages);
+            _uncharge_container(container, (__u64)nr_pages << PAGE_SHIFT);
+            return ERR_PTR(-ENOMEM);
+        }
+    }
+    new_object_node->container = container;
+    new_object_node->offset = offset;
+    new_object_node->nr_pages = nr_pages;
+    kref_init(&new_object_node->ref);  // owned by the object index
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    new_object_node->huge = (container->flags & MCONTAINER_CREATE_HUGEPAGE) && nr_pages >= OBJECT_HUGE_PAGES &&
+            container->pool_pages == 0;
+#else
+    new_object_node->huge = 0;
+#endif
+
+    if (radix_tree_preload(GFP_KERNEL)) {
+        _discard_object_node(container, new_object_node);
+        _uncharge_container(container, (__u64)nr_pages << PAGE_SHIFT);
+        return ERR_PTR(-ENOMEM);
+    }
+    spin_lock(&container->object_lock);
+    // the index of a dead container was emptied for good
+    if (container->dead) {
+        spin_unlock(&container->object_lock);
+        radix_tree_preload_end();
+        _discard_object_node(container, new_object_node);
+        _uncharge_container(container, (__u64)nr_pages << PAGE_SHIFT);
+        return ERR_PTR(-EINVAL);
+    }
+    ret = radix_tree_insert(&container->mem_objects, offset, new_object_node);
+    if (ret == 0) {
+        container->num_objects = container->num_objects + 1;
+        kref_get(&container->ref);
+        existing_object = new_object_node;
+    } else {
+        existing_object = (ObjectNode*)radix_tree_lookup(&container->mem_objects, offset);
+    }
+    // objects in the index still hold the index's reference
+    kref_get(&existing_object->ref);
+    spin_unlock(&container->object_lock);
+    radix_tree_preload_end();
+
+    if (existing_object != new_object_node) {
+        _discard_object_node(container, new_object_node);
+        _uncharge_container(container, (__u64)nr_pages << PAGE_SHIFT);
+    }
+    return existing_object;
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/**
+ * Returns index of first page of the huge chunk holding given index
+ * Chunks are aligned on the mmap offset, matching the addresses 
+ * handed out by thp_get_unmapped_area()
+ * @return Index of first page, -1 if index is not inside a whole chunk
+ */
+long _get_object_chunk(ObjectNode *object, unsigned long index) {
+    __u64 first = round_down(object->offset + index, OBJECT_HUGE_PAGES);
+
+    if (first < object->offset || first + OBJECT_HUGE_PAGES > object->offset + object->nr_pages) {
+        return -1;
+    }
+    return first - object->offset;
+}
+
+/**
+ * Backs the chunk holding given index with one physically contiguous block
+ * The block is split, so every page is refcounted like a small page and 
+ * can be mapped by page through an arena or a private mapping, and by pfn,
+ * with a PMD or single PTEs, through a shared one, pages raced in by 
+ * another fault are kept and the matching part of the block is freed
+ */
+void _fill_object_chunk(ObjectNode *object, unsigned long index) {
+    struct page *chunk;
+    unsigned long i;
+    long first = _get_object_chunk(object, index);
+
+    if (first < 0) {
+        return;
+    }
+
+    chunk = alloc_pages(GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN | __GFP_NORETRY, OBJECT_HUGE_ORDER);
+    if (chunk == NULL) {
+        return;
+    }
+    split_page(chunk, OBJECT_HUGE_ORDER);
+
+    for (i = 0; i < OBJECT_HUGE_PAGES; i++) {
+        if (cmpxchg(&object->pages[first + i], NULL, nth_page(chunk, i)) != NULL) {
+            __free_page(nth_page(chunk, i));
+        } else {
+            this_cpu_inc(object->container->stats->resident_pages);
+        }
+    }
+}
+
+/**
+ * Checks whether the chunk starting at given index can be mapped by a PMD
+ */
+bool _object_chunk_is_contiguous(ObjectNode *object, unsigned long first) {
+    unsigned long pfn, i;
+
+    if (object->pages[first] == NULL) {
+        return false;
+    }
+    pfn = page_to_pfn(object->pages[first]);
+    if (!IS_ALIGNED(pfn, OBJECT_HUGE_PAGES)) {
+        return false;
+    }
+    for (i = 1; i < OBJECT_HUGE_PAGES; i++) {
+        if (object->pages[first + i] == NULL || page_to_pfn(object->pages[first + i]) != pfn + i) {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+/**
+ * Returns backing page at given index of given object
+ * Allocates a zeroed page if the index was never touched, 
+ * from the container's pool if it has one
+ * Huge objects try to back the whole surrounding chunk first
+ * @return Page, NULL if out of memory
+ */
+void* _get_object_page(ObjectNode *object, unsigned long index) {
+    struct page *page = READ_ONCE(object->pages[index]);
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    if (page == NULL && object->huge) {
+        _fill_object_chunk(object, index);
+        page = READ_ONCE(object->pages[index]);
+    }
+#endif
+    if (page == NULL) {
+        if (object->container->pool_pages != 0) {
+            page = (struct page*)_take_pool_page(object->container);
+        } else {
+            page = alloc_page(GFP_HIGHUSER | __GFP_ZERO);
+        }
+        if (page == NULL) {
+            return NULL;
+        }
+        // two tasks may fault on the same page, keep the first one
+        if (cmpxchg(&object->pages[index], NULL, page) != NULL) {
+            if (object->container->pool_pages != 0) {
+                _put_pool_page(object->container, page);
+            } else {
+                __free_page(page);
+            }
+            page = object->pages[index];
+        } else {
+            this_cpu_inc(object->container->stats->resident_pages);
+        }
+    }
+    return page;
+}
+
+// objects without references left, freed in batches off the FREE path
+static LLIST_HEAD(object_free_list);
+
+/**
+ * Recycles or frees objects queued on object_free_list
+ * One RCU grace period covers the whole batch, lockless lookups 
+ * may still see the nodes but cannot take a reference anymore,
+ * after it nodes can be reused without readers mistaking them
+ */
+void _free_objects_work(struct work_struct *work) {
+    struct llist_node *batch = llist_del_all(&object_free_list);
+    ObjectNode *object, *next;
+
+    if (batch == NULL) {
+        return;
+    }
+    synchronize_rcu();
+    llist_for_each_entry_safe(object, next, batch, f_node) {
+        ContainerNode *container = object->container;
+        _discard_object_node(container, object);
+        _put_container(container);
+    }
+}
+
+static DECLARE_WORK(object_free_work, _free_objects_work);
+
+/**
+ * Queues an object without references for object_free_work
+ */
+void _queue_object_free(struct kref *ref) {
+    ObjectNode *object = container_of(ref, ObjectNode, ref);
+
+    // only the first object of a batch needs to kick the work
+    if (llist_add(&object->f_node, &object_free_list)) {
+        queue_work(system_unbound_wq, &object_free_work);
+    }
+}
+
+/**
+ * Drops a reference on given object
+ */
+void _put_memory_object(ObjectNode *object) {
+    kref_put(&object->ref, _queue_object_free);
+}
+
+/**
+ * Zaps the slot of an object that left the index out of every arena of 
+ * its container, so arenas do not keep mapping pages of a freed object
+ * Arena faults check the index with the page locked until the PTE is in,
+ * taking each page lock waits for faults that found the object indexed
+ * Arenas of other containers at the same offsets are zapped as well and
+ * fault their pages in again
+ */
+void _zap_arena_slots(ContainerNode *container, ObjectNode *object) {
+    ArenaNode *arena;
+    struct page *page;
+    unsigned long i;
+    loff_t first;
+
+    mutex_lock(&container->arena_lock);
+    if (list_empty(&container->arenas)) {
+        mutex_unlock(&container->arena_lock);
+        return;
+    }
+    // pairs with cmpxchg() in _get_object_page(), a page missed here 
+    // belongs to a fault that sees the object gone
+    smp_mb();
+    for (i = 0; i < object->nr_pages; i++) {
+        page = READ_ONCE(object->pages[i]);
+        if (page != NULL) {
+            lock_page(page);
+            unlock_page(page);
+        }
+    }
+    list_for_each_entry(arena, &container->arenas, a_node) {
+        if (object->offset < arena->first_oid || object->offset - arena->first_oid >= arena->nr_slots) {
+            continue;
+        }
+        first = arena->pgoff + (object->offset - arena->first_oid) * arena->slot_pages;
+        // private copies made by writes stay with their mappings
+        unmap_mapping_range(arena->mapping, first << PAGE_SHIFT, (loff_t)arena->slot_pages << PAGE_SHIFT, 0);
+    }
+    mutex_unlock(&container->arena_lock);
+}
+
+/**
+ * Removes object with given offset from object index of given container
+ * @param  container Container holding the object
+ * @param  offset    Offset of memory object
+ * @return       
+ */
+void _remove_memory_object(ContainerNode *container, __u64 offset) {
+    ObjectNode *temp_object;
+
+    spin_lock(&container->object_lock);
+    temp_object = (ObjectNode*)radix_tree_delete(&container->mem_objects, offset);
+    if (temp_object != NULL) {
+        container->num_objects = container->num_objects - 1;
+    }
+    spin_unlock(&container->object_lock);
+
+    if (temp_object != NULL) {
+        trace_mcontainer_free(container->id, offset, temp_object->nr_pages << PAGE_SHIFT);
+        _uncharge_container(container, (__u64)temp_object->nr_pages << PAGE_SHIFT);
+        _zap_arena_slots(container, temp_object);
+        // memory is freed once the last mapping of the object is gone
+        _put_memory_object(temp_object);
+    }
+}
+
+/**
+ * Returns the lock table bucket for given object
+ * @param  container Container holding the object
+ * @param  oid       Offset of memory object
+ * @return           Lock Bucket
+ */
+LockBucket* _get_lock_bucket(ContainerNode *container, __u64 oid) {
+    return &lock_table[hash_64(oid ^ (__u64)(unsigned long)container, LOCK_TABLE_BITS)];
+}
+
+/**
+ * Finds the lock node of given object in given bucket
+ * Must be called with bucket lock held
+ * @return Lock Node, NULL if nobody holds or waits on the lock
+ */
+void* _find_lock_node(LockBucket *bucket, ContainerNode *container, __u64 oid) {
+    LockNode *temp_lock;
+    hlist_for_each_entry(temp_lock, &bucket->chain, l_node) {
+        if (temp_lock->container == container && temp_lock->oid == oid) {
+            return temp_lock;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Finds or creates the lock node of given object and takes a reference on it
+ * @return Lock Node, NULL if out of memory
+ */
+void* _get_lock_node(LockBucket *bucket, ContainerNode *container, __u64 oid) {
+    LockNode *temp_lock, *new_lock = NULL;
+
+    spin_lock(&bucket->lock);
+    temp_lock = (LockNode*)_find_lock_node(bucket, container, oid);
+    if (temp_lock == NULL) {
+        // allocate outside of the bucket lock and look again
+        spin_unlock(&bucket->lock);
+        new_lock = (LockNode*)kmem_cache_alloc(lock_cache, GFP_KERNEL);
+        if (new_lock == NULL) {
+            return NULL;
+        }
+        new_lock->container = container;
+        new_lock->oid = oid;
+        new_lock->writer = 0;
+        new_lock->readers = 0;
+        new_lock->refs = 0;
+        INIT_LIST_HEAD(&new_lock->waiters);
+        init_waitqueue_head(&new_lock->wait);
+
+        spin_lock(&bucket->lock);
+        temp_lock = (LockNode*)_find_lock_node(bucket, container, oid);
+        if (temp_lock == NULL) {
+            hlist_add_head(&new_lock->l_node, &bucket->chain);
+            temp_lock = new_lock;
+            new_lock = NULL;
+        }
+    }
+    temp_lock->refs = temp_lock->refs + 1;
+    spin_unlock(&bucket->lock);
+
+    if (new_lock != NULL) {
+        kmem_cache_free(lock_cache, new_lock);
+    }
+    return temp_lock;
+}
+
+/**
+ * Drops a reference on given lock node, freeing it with the last one
+ * Must be called with bucket lock held
+ */
+void _put_lock_node(LockNode *lock_node) {
+    lock_node->refs = lock_node->refs - 1;
+    if (lock_node->refs == 0) {
+        hlist_del(&lock_node->l_node);
+        kmem_cache_free(lock_cache, lock_node);
+    }
+}
+
+/**
+ * Takes given lock for a holder in given mode, if the mode allows it
+ * Must be called with bucket lock held
+ * @return true if lock was acquired
+ */
+bool _try_acquire_lock_node(LockNode *lock_node, int shared) {
+    if (lock_node->writer || (!shared && lock_node->readers > 0)) {
+        return false;
+    }
+    if (shared) {
+        if (lock_node->readers++ == 0) {
+            lock_node->acquired_ns = ktime_get_ns();
+        }
+    } else {
+        lock_node->writer = 1;
+        lock_node->acquired_ns = ktime_get_ns();
+    }
+    return true;
+}
+
+/**
+ * Hands the lock over to waiters at the head of the queue
+ * A writer is granted the lock alone, readers are granted it together 
+ * up to the next queued writer, so that neither side can starve
+ * Must be called with bucket lock held
+ */
+void _grant_lock_waiters(LockNode *lock_node) {
+    LockWaiter *waiter, *next;
+    bool granted = false;
+
+    list_for_each_entry_safe(waiter, next, &lock_node->waiters, w_list) {
+        if (!_try_acquire_lock_node(lock_node, waiter->shared)) {
+            break;
+        }
+        list_del_init(&waiter->w_list);
+        if (waiter->file != NULL) {
+            // the file cannot go away while it has a request queued on this lock
+            spin_lock(&waiter->file->request_lock);
+            waiter->granted = 1;
+            waiter->file->nr_granted++;
+            wake_up_interruptible_poll(&waiter->file->poll_wait, EPOLLIN | EPOLLRDNORM);
+            spin_unlock(&waiter->file->request_lock);
+        } else {
+            smp_store_release(&waiter->granted, 1);
+            granted = true;
+        }
+    }
+    if (granted) {
+        wake_up_all(&lock_node->wait);
+    }
+}
+
+/**
+ * Returns the oid whose lock guards given object
+ * Containers created with MCONTAINER_CREATE_CONTAINER_LOCK share one lock
+ */
+__u64 _get_lock_oid(ContainerNode *container, __u64 oid) {
+    if (container->flags & MCONTAINER_CREATE_CONTAINER_LOCK) {
+        return CONTAINER_LOCK_OID;
+    }
+    return oid;
+}
+
+/**
+ * Acquires the lock of given object, sleeping while it is held in a conflicting mode
+ * Tasks arriving while others wait queue up behind them
+ * A waiter leaving early takes itself off the queue, which may let 
+ * the waiters behind it in
+ * @param  container Container holding the object
+ * @param  oid       Offset of memory object
+ * @param  shared    Nonzero to share the lock with other readers
+ * @param  timeout   Jiffies to wait, 0 to fail right away, MAX_SCHEDULE_TIMEOUT 
+ *                   to wait until granted or killed, bounded waits are interruptible
+ * @return           0 on success, -EBUSY if timeout was 0 and the lock was not free, 
+ *                   -ETIMEDOUT, -EINTR, or -ENOMEM
+ */
+int _lock_object(ContainerNode *container, __u64 oid, int shared, long timeout) {
+    LockBucket *bucket;
+    LockNode *lock_node;
+    LockWaiter waiter;
+    ContainerStats *stats;
+    u64 start_ns = ktime_get_ns();
+    long ret;
+
+    oid = _get_lock_oid(container, oid);
+    bucket = _get_lock_bucket(container, oid);
+    lock_node = (LockNode*)_get_lock_node(bucket, container, oid);
+    if (lock_node == NULL) {
+        return -ENOMEM;
+    }
+
+    spin_lock(&bucket->lock);
+    if (list_empty(&lock_node->waiters) && _try_acquire_lock_node(lock_node, shared)) {
+        spin_unlock(&bucket->lock);
+    } else if (timeout == 0) {
+        _put_lock_node(lock_node);
+        spin_unlock(&bucket->lock);
+        return -EBUSY;
+    } else {
+        waiter.shared = shared;
+        waiter.granted = 0;
+        waiter.file = NULL;
+        list_add_tail(&waiter.w_list, &lock_node->waiters);
+        spin_unlock(&bucket->lock);
+
+        if (timeout == MAX_SCHEDULE_TIMEOUT) {
+            ret = wait_event_killable(lock_node->wait, smp_load_acquire(&waiter.granted));
+        } else {
+            ret = wait_event_interruptible_timeout(lock_node->wait, smp_load_acquire(&waiter.granted), timeout);
+        }
+
+        if (!smp_load_acquire(&waiter.granted)) {
+            spin_lock(&bucket->lock);
+            // the lock may have been handed over since the wait ended, then keep it
+            if (!waiter.granted) {
+                list_del(&waiter.w_list);
+                _grant_lock_waiters(lock_node);
+                _put_lock_node(lock_node);
+                spin_unlock(&bucket->lock);
+                return ret == 0 ? -ETIMEDOUT : -EINTR;
+            }
+            spin_unlock(&bucket->lock);
+        }
+    }
+
+    stats = get_cpu_ptr(container->stats);
+    stats->lock_acquisitions++;
+    _stats_hist_add(stats->lock_wait_hist, ktime_get_ns() - start_ns);
+    put_cpu_ptr(container->stats);
+    return 0;
+}
+
+/**
+ * Releases the lock of given object, in whichever mode caller holds it,
+ * and hands it over to the waiters next in line
+ * Hold time of shared locks is recorded when the last reader leaves
+ * @param  container Container holding the object
+ * @param  oid       Offset of memory object
+ * @return           0 on success, -EINVAL if lock was not held
+ */
+int _unlock_object(ContainerNode *container, __u64 oid) {
+    LockBucket *bucket;
+    LockNode *lock_node;
+
+    oid = _get_lock_oid(container, oid);
+    bucket = _get_lock_bucket(container, oid);
+
+    spin_lock(&bucket->lock);
+    lock_node = (LockNode*)_find_lock_node(bucket, container, oid);
+    if (lock_node == NULL || (!lock_node->writer && lock_node->readers == 0)) {
+        spin_unlock(&bucket->lock);
+        return -EINVAL;
+    }
+    if (lock_node->writer) {
+        lock_node->writer = 0;
+    } else {
+        lock_node->readers = lock_node->readers - 1;
+    }
+    if (lock_node->readers == 0) {
+        _stats_hist_add(this_cpu_ptr(container->stats)->lock_hold_hist, ktime_get_ns() - lock_node->acquired_ns);
+    }
+    _grant_lock_waiters(lock_node);
+    _put_lock_node(lock_node);
+    spin_unlock(&bucket->lock);
+    return 0;
+}
+
+/**
+ * Requests the lock of given object without waiting for it
+ * A request that cannot be granted right away is queued like a sleeping 
+ * task and reported through poll() of the file once it is granted
+ * @return 0 if the lock was taken right away, -EINPROGRESS if the request 
+ *         was queued, -ENOMEM
+ */
+int _lock_object_async(FileNode *file, ContainerNode *container, __u64 oid, int shared) {
+    LockRequest *request;
+    LockBucket *bucket;
+    LockNode *lock_node;
+    __u64 lock_oid = _get_lock_oid(container, oid);
+
+    request = (LockRequest*)kmalloc(sizeof(LockRequest), GFP_KERNEL);
+    if (request == NULL) {
+        return -ENOMEM;
+    }
+    bucket = _get_lock_bucket(container, lock_oid);
+    lock_node = (LockNode*)_get_lock_node(bucket, container, lock_oid);
+    if (lock_node == NULL) {
+        kfree(request);
+        return -ENOMEM;
+    }
+
+    spin_lock(&bucket->lock);
+    if (list_empty(&lock_node->waiters) && _try_acquire_lock_node(lock_node, shared)) {
+        spin_unlock(&bucket->lock);
+        kfree(request);
+        this_cpu_inc(container->stats->lock_acquisitions);
+        return 0;
+    }
+    request->waiter.shared = shared;
+    request->waiter.granted = 0;
+    request->waiter.file = file;
+    kref_get(&container->ref);  // dropped once the request is freed
+    request->container = container;
+    request->bucket = bucket;
+    request->lock_node = lock_node;
+    request->oid = oid;
+
+    spin_lock(&file->request_lock);
+    list_add_tail(&request->r_list, &file->requests);
+    spin_unlock(&file->request_lock);
+    list_add_tail(&request->waiter.w_list, &lock_node->waiters);
+    spin_unlock(&bucket->lock);
+    return -EINPROGRESS;
+}
+
+/**
+ * Withdraws an asynchronous request, releasing the lock if it was granted already
+ * The caller must have taken the request off its file's list
+ */
+void _cancel_lock_request(FileNode *file, LockRequest *request) {
+    LockBucket *bucket = request->bucket;
+    int granted;
+
+    spin_lock(&bucket->lock);
+    spin_lock(&file->request_lock);
+    granted = request->waiter.granted;
+    if (granted) {
+        file->nr_granted = file->nr_granted - 1;
+    }
+    spin_unlock(&file->request_lock);
+    if (!granted) {
+        list_del(&request->waiter.w_list);
+        _grant_lock_waiters(request->lock_node);
+        _put_lock_node(request->lock_node);
+    }
+    spin_unlock(&bucket->lock);
+
+    if (granted) {
+        _unlock_object(request->container, request->oid);
+    }
+    _put_container(request->container);
+    kfree(request);
+}
+
+/**
+ * Returns the lock page of given container, allocating it on first use
+ * @return Lock page, NULL if out of memory
+ */
+void* _get_lock_page(ContainerNode *container) {
+    struct page *lock_page = READ_ONCE(container->lock_page);
+
+    if (lock_page == NULL) {
+        lock_page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+        if (lock_page == NULL) {
+            return NULL;
+        }
+        // keep the page installed by a concurrent caller, if any
+        if (cmpxchg(&container->lock_page, NULL, lock_page) != NULL) {
+            __free_page(lock_page);
+            lock_page = container->lock_page;
+        }
+    }
+    return lock_page;
+}
+
+/**
+ * Returns the wait queue for given lock word of given container
+ */
+wait_queue_head_t* _get_user_lock_wait_queue(ContainerNode *container, __u64 slot) {
+    return &user_lock_wait_table[hash_64(slot ^ (__u64)(unsigned long)container, USER_LOCK_WAIT_BITS)];
+}
+
+/**
+ * Maps the lock page of caller's container
+ * Lock words are taken with atomic operations in user space, 
+ * the kernel is only entered to sleep and wake up under contention
+ */
+int _mmap_lock_page(ContainerNode *container, struct vm_area_struct *vma) {
+    struct page *lock_page;
+
+    if (vma->vm_end - vma->vm_start != PAGE_SIZE) {
+        return -EINVAL;
+    }
+    lock_page = (struct page*)_get_lock_page(container);
+    if (lock_page == NULL) {
+        return -ENOMEM;
+    }
+    return vm_insert_page(vma, vma->vm_start, lock_page);
+}
+
+/**
+ * Unlinks a container without tasks from the container table
+ * Must be called with the container's task lock held
+ * @return true if the caller has to finish with _teardown_container()
+ */
+bool _retire_container(ContainerNode *container) {
+    if (container->num_tasks != 0 || container->dead) {
+        return false;
+    }
+    container->dead = 1;
+    // the stats file is named by cid, it has to be gone before a container
+    // with the same id can be created
+    debugfs_remove(container->debugfs_file);
+    container->debugfs_file = NULL;
+    rhashtable_remove_fast(&container_table, &container->c_node, container_table_params);
+    return true;
+}
+
+/**
+ * Frees the objects of a retired container and drops the table's reference
+ * Objects still mapped are freed once their last mapping goes away,
+ * the container itself once nothing refers to it anymore
+ */
+void _teardown_container(ContainerNode *container) {
+    ObjectNode *temp_object;
+    __u64 offset = 0;
+
+    mutex_lock(&idle_lock);
+    list_del_init(&container->idle_list);
+    mutex_unlock(&idle_lock);
+
+    // objects cannot be added anymore once the container is dead,
+    // they are removed one at a time since arenas may have to be zapped
+    for (;;) {
+        rcu_read_lock();
+        if (radix_tree_gang_lookup(&container->mem_objects, (void**)&temp_object, offset, 1) == 0) {
+            rcu_read_unlock();
+            break;
+        }
+        offset = temp_object->offset;
+        rcu_read_unlock();
+        _remove_memory_object(container, offset);
+    }
+    _drain_free_lists(container);
+
+    debugfs_remove(container->debugfs_file);
+    container->debugfs_file = NULL;
+    _put_container(container);
+}
+
+/**
+ * Tears down containers whose grace period is over
+ * A container joined by a task meanwhile has left the idle list already
+ * Containers stay on the list while container_grace_ms is negative
+ */
+void _reap_idle_containers(struct work_struct *work) {
+    int grace_ms = READ_ONCE(container_grace_ms);
+    unsigned long grace = msecs_to_jiffies(max(grace_ms, 0));
+    ContainerNode *container;
+    bool retire;
+
+    if (grace_ms < 0) {
+        return;
+    }
+    for (;;) {
+        mutex_lock(&idle_lock);
+        container = list_first_entry_or_null(&idle_containers, ContainerNode, idle_list);
+        if (container == NULL) {
+            mutex_unlock(&idle_lock);
+            return;
+        }
+        if (time_before(jiffies, container->idle_since + grace)) {
+            // the rest of the list went idle later
+            schedule_delayed_work(to_delayed_work(work), container->idle_since + grace - jiffies);
+            mutex_unlock(&idle_lock);
+            return;
+        }
+        list_del_init(&container->idle_list);
+        kref_get(&container->ref);
+        mutex_unlock(&idle_lock);
+
+        mutex_lock(&container->task_lock);
+        retire = _retire_container(container);
+        mutex_unlock(&container->task_lock);
+        if (retire) {
+            _teardown_container(container);
+        }
+        _put_container(container);
+    }
+}
+
+static DECLARE_DELAYED_WORK(idle_work, _reap_idle_containers);
+
+/**
+ * Sets container_grace_ms and rescans the idle containers, so the new
+ * value applies to containers which went idle before, kept ones included
+ */
+int _set_container_grace_ms(const char *val, const struct kernel_param *kp) {
+    int ret = param_set_int(val, kp);
+    bool idle;
+
+    if (ret) {
+        return ret;
+    }
+    // nothing is idle while the module is loaded with the parameter
+    mutex_lock(&idle_lock);
+    idle = !list_empty(&idle_containers);
+    mutex_unlock(&idle_lock);
+    if (idle) {
+        mod_delayed_work(system_wq, &idle_work, 0);
+    }
+    return 0;
+}
+
+static const struct kernel_param_ops container_grace_ms_ops = {
+    .set = _set_container_grace_ms,
+    .get = param_get_int,
+};
+
+module_param_cb(container_grace_ms, &container_grace_ms_ops, &container_grace_ms, 0644);
+MODULE_PARM_DESC(container_grace_ms, "Time a container without tasks keeps its objects, negative to keep them");
+
+/**
+ * Removes task from given container
+ * The last task leaving tears the container down, right away 
+ * or once container_grace_ms have passed without a task joining,
+ * with a negative container_grace_ms the container is kept on the 
+ * idle list until the parameter changes
+ */
+void _deregister_task_from_container(pid_t tid) {
+    TaskNode *temp_task;
+    ContainerNode *temp_container;
+    int grace_ms = READ_ONCE(container_grace_ms);
+    bool retire = false;
+
+    rcu_read_lock();
+    temp_task = (TaskNode*)_get_task(tid);
+    // only the caller which unlinks the node from table frees it
+    if (temp_task == NULL || 
+            rhashtable_remove_fast(&task_table, &temp_task->t_node, task_table_params)) {
+        rcu_read_unlock();
+        return;
+    }
+    rcu_read_unlock();
+
+    temp_container = temp_task->container;
+    mutex_lock(&temp_container->task_lock);
+    temp_container->num_tasks = temp_container->num_tasks - 1;
+    list_del(&temp_task->task_list);
+    if (temp_container->num_tasks == 0) {
+        if (grace_ms == 0) {
+            retire = _retire_container(temp_container);
+        } else {
+            mutex_lock(&idle_lock);
+            temp_container->idle_since = jiffies;
+            list_add_tail(&temp_container->idle_list, &idle_containers);
+            mutex_unlock(&idle_lock);
+            // read again, a change that missed the container on the list is seen here
+            grace_ms = READ_ONCE(container_grace_ms);
+            if (grace_ms >= 0) {
+                schedule_delayed_work(&idle_work, msecs_to_jiffies(grace_ms));
+            }
+        }
+    }
+    mutex_unlock(&temp_container->task_lock);
+    call_rcu(&temp_task->rcu, _free_task_rcu);
+    if (retire) {
+        _teardown_container(temp_container);
+    }
+}
+
+/**
+ * Associates given task with given container
+ * Checks whether given task already exists in given container, 
+ * if not, creates a new entry for given task in the container
+ * A task bound to another container is moved to the given one
+ * @param cid Container id 
+ * @param tid Task id
+ * @return    0 on success, -EAGAIN if the container was torn down meanwhile,
+ *            negative error code otherwise
+ */
+int _register_task(__u64 cid, struct task_struct *task_ptr) {
+    // Do not add new task if it already exists
+    if (_task_exists(cid, task_ptr->tgid)) {
+        return 0;
+    }
+
+    _deregister_task_from_container(task_ptr->tgid);
+
+    return _add_new_task(cid, task_ptr);
+}
+
+/**
+ * Tears down a container along with its tasks
+ * Called for every container while the table is destroyed
+ */
+void _free_container(void *ptr, void *arg) {
+    ContainerNode *temp_container = (ContainerNode*)ptr;
+    struct list_head *t_pos, *t_q;
+
+    list_for_each_safe(t_pos, t_q, &temp_container->t_list) {
+        TaskNode *temp_task = list_entry(t_pos, TaskNode, task_list);
+        list_del(t_pos);
+        kmem_cache_free(task_cache, temp_task);
+    }
+    temp_container->num_tasks = 0;
+    temp_container->dead = 1;
+    _teardown_container(temp_container);
+}
+
+/**
+ * Initializes the container and task tables and the node caches
+ * @return 0 on success, negative error code otherwise
+ */
+int _init_tables(void) {
+    int i, ret;
+
+    ret = _init_caches();
+    if (ret) {
+        return ret;
+    }
+
+    ret = rhashtable_init(&container_table, &container_table_params);
+    if (ret) {
+        _destroy_caches();
+        return ret;
+    }
+
+    ret = rhashtable_init(&task_table, &task_table_params);
+    if (ret) {
+        rhashtable_destroy(&container_table);
+        _destroy_caches();
+        return ret;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(lock_table); i++) {
+        spin_lock_init(&lock_table[i].lock);
+        INIT_HLIST_HEAD(&lock_table[i].chain);
+    }
+    for (i = 0; i < ARRAY_SIZE(user_lock_wait_table); i++) {
+        init_waitqueue_head(&user_lock_wait_table[i]);
+    }
+
+    free_list_shrinker = _create_shrinker("mcontainer-free-lists", _free_lists_count, _free_lists_scan);
+    if (free_list_shrinker == NULL) {
+        rhashtable_destroy(&task_table);
+        rhashtable_destroy(&container_table);
+        _destroy_caches();
+        return -ENOMEM;
+    }
+
+    // statistics are optional, a failure here is not fatal
+    debugfs_root = debugfs_create_dir("mcontainer", NULL);
+    return 0;
+}
+
+/**
+ * Cleans up all data structures
+ */
+void _clean_up(void) {
+    _destroy_shrinker(free_list_shrinker);
+    cancel_delayed_work_sync(&idle_work);
+    // task nodes are freed along with the container holding them
+    rhashtable_destroy(&task_table);
+    rhashtable_free_and_destroy(&container_table, _free_container, NULL);
+    // objects hold the last references on their containers
+    flush_work(&object_free_work);
+    debugfs_remove_recursive(debugfs_root);
+    _destroy_caches();
+}
+
+/**
+ * Installs the backing page of an object on first touch
+ * Pages are indexed from the object's offset, not from vm_pgoff,
+ * which moves for the upper part of a VMA split by munmap() or mprotect()
+ */
+vm_fault_t memory_container_fault(struct vm_fault *vmf)
+{
+    struct page *page;
+    ObjectNode *object = (ObjectNode*)vmf->vma->vm_private_data;
+    unsigned long index = vmf->pgoff - object->offset;
+
+    if (index >= object->nr_pages) {
+        return VM_FAULT_SIGBUS;
+    }
+    // like shmem after truncation, a freed object gets no new pages
+    if (READ_ONCE(object->pages[index]) == NULL && !_object_is_indexed(object)) {
+        return VM_FAULT_SIGBUS;
+    }
+
+    page = (struct page*)_get_object_page(object, index);
+    if (page == NULL) {
+        return VM_FAULT_OOM;
+    }
+
+    // huge objects are mapped by pfn, their PTEs hold no page references
+    if (vmf->vma->vm_flags & VM_PFNMAP) {
+        return vmf_insert_pfn(vmf->vma, vmf->address, page_to_pfn(page));
+    }
+
+    // the reference taken here is owned by the page table entry
+    get_page(page);
+    vmf->page = page;
+    return 0;
+}
+
+#ifdef MCONTAINER_HUGE_FAULT
+/**
+ * Maps a whole chunk of a huge object with a single PMD
+ * Falls back to memory_container_fault() when the address range is
+ * not aligned or no contiguous block could be allocated
+ * The PMD maps pfns of a VM_PFNMAP VMA, so core mm never treats the 
+ * split block behind it as a transparent huge page
+ */
+vm_fault_t memory_container_huge_fault(struct vm_fault *vmf, fault_size_t size)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    ObjectNode *object = (ObjectNode*)vma->vm_private_data;
+    unsigned long address = vmf->address & PMD_MASK;
+    unsigned long index = vmf->pgoff - object->offset;
+    long first;
+
+    if (size != FAULT_SIZE_PMD || !(vma->vm_flags & VM_PFNMAP)) {
+        return VM_FAULT_FALLBACK;
+    }
+    if (address < vma->vm_start || address + PMD_SIZE > vma->vm_end || index >= object->nr_pages) {
+        return VM_FAULT_FALLBACK;
+    }
+    first = _get_object_chunk(object, index);
+    if (first < 0 || first != index - ((vmf->address - address) >> PAGE_SHIFT)) {
+        return VM_FAULT_FALLBACK;
+    }
+
+    if (READ_ONCE(object->pages[first]) == NULL && !_object_is_indexed(object)) {
+        return VM_FAULT_FALLBACK;
+    }
+    if (_get_object_page(object, first) == NULL || !_object_chunk_is_contiguous(object, first)) {
+        return VM_FAULT_FALLBACK;
+    }
+    return vmf_insert_pfn_pmd(vmf, page_to_pmd_pfn(object->pages[first]), vmf->flags & FAULT_FLAG_WRITE);
+}
+#endif
+
+void memory_container_vm_open(struct vm_area_struct *vma)
+{
+    kref_get(&((ObjectNode*)vma->vm_private_data)->ref);
+}
+
+void memory_container_vm_close(struct vm_area_struct *vma)
+{
+    _put_memory_object((ObjectNode*)vma->vm_private_data);
+}
+
+static const struct vm_operations_struct memory_container_vm_ops = {
+    .open = memory_container_vm_open,
+    .close = memory_container_vm_close,
+    .fault = memory_container_fault,
+#ifdef MCONTAINER_HUGE_FAULT
+    .huge_fault = memory_container_huge_fault,
+#endif
+};
+
+/**
+ * Installs a page of an arena on first touch
+ * The object of the slot is created if it does not exist yet, 
+ * with the slot's size
+ */
+vm_fault_t memory_container_arena_fault(struct vm_fault *vmf)
+{
+    struct page *page;
+    ObjectNode *object;
+    ArenaNode *arena = (ArenaNode*)vmf->vma->vm_private_data;
+    unsigned long index = vmf->pgoff - arena->pgoff;
+    unsigned long slot = index / arena->slot_pages;
+    __u64 oid = arena->first_oid + slot;
+
+    if (slot >= arena->nr_slots) {
+        return VM_FAULT_SIGBUS;
+    }
+
+    object = (ObjectNode*)_get_memory_object(arena->container, oid);
+    if (object == NULL) {
+        object = (ObjectNode*)_add_new_memory_object(arena->container, oid, arena->slot_pages);
+        // like shmem past its size, an object over the limit cannot be touched
+        if (IS_ERR(object)) {
+            return VM_FAULT_SIGBUS;
+        }
+        this_cpu_inc(arena->container->stats->mmap_allocs);
+        trace_mcontainer_mmap(arena->container->id, oid, arena->slot_pages << PAGE_SHIFT, 1);
+    }
+
+    // the object may have been created smaller through its own mapping
+    // PTEs hold page references, so the object is only needed during the fault
+    index -= slot * arena->slot_pages;
+    if (index >= object->nr_pages) {
+        _put_memory_object(object);
+        return VM_FAULT_SIGBUS;
+    }
+
+    page = (struct page*)_get_object_page(object, index);
+    if (page == NULL) {
+        _put_memory_object(object);
+        return VM_FAULT_OOM;
+    }
+    // FREE zaps the slot once it has taken this lock, so the object is 
+    // checked under it and the PTE installed before it is released
+    lock_page(page);
+    if (!_object_is_indexed(object)) {
+        unlock_page(page);
+        _put_memory_object(object);
+        return VM_FAULT_NOPAGE;
+    }
+    get_page(page);
+    _put_memory_object(object);
+    vmf->page = page;
+    return VM_FAULT_LOCKED;
+}
+
+void _free_arena(struct kref *ref) {
+    ArenaNode *arena = container_of(ref, ArenaNode, ref);
+
+    mutex_lock(&arena->container->arena_lock);
+    list_del(&arena->a_node);
+    mutex_unlock(&arena->container->arena_lock);
+    _put_container(arena->container);
+    kfree(arena);
+}
+
+void memory_container_arena_open(struct vm_area_struct *vma)
+{
+    kref_get(&((ArenaNode*)vma->vm_private_data)->ref);
+}
+
+void memory_container_arena_close(struct vm_area_struct *vma)
+{
+    kref_put(&((ArenaNode*)vma->vm_private_data)->ref, _free_arena);
+}
+
+static const struct vm_operations_struct memory_container_arena_vm_ops = {
+    .open = memory_container_arena_open,
+    .close = memory_container_arena_close,
+    .fault = memory_container_arena_fault,
+};
+
+/**
+ * Maps an arena over a range of objects of given container
+ * The offset carries the first oid and the slot size, see MCONTAINER_ARENA_OID
+ * @return 0 on success, -EINVAL if the offset or length do not describe an arena
+ */
+int _mmap_arena(ContainerNode *container, struct vm_area_struct *vma) {
+    ArenaNode *arena;
+    unsigned long slot_pages = (vma->vm_pgoff >> MCONTAINER_ARENA_SLOT_SHIFT) & MCONTAINER_ARENA_SLOT_MAX;
+    unsigned long nr_pages = vma_pages(vma);
+    __u64 known_bits = MCONTAINER_ARENA_OFFSET(MCONTAINER_ARENA_FIRST_OID_MAX, MCONTAINER_ARENA_SLOT_MAX);
+
+    if ((vma->vm_pgoff & ~known_bits) || slot_pages == 0 || nr_pages % slot_pages != 0) {
+        return -EINVAL;
+    }
+
+    arena = (ArenaNode*)kmalloc(sizeof(ArenaNode), GFP_KERNEL);
+    if (arena == NULL) {
+        return -ENOMEM;
+    }
+    kref_get(&container->ref);  // dropped by _free_arena()
+    arena->container = container;
+    arena->first_oid = vma->vm_pgoff & MCONTAINER_ARENA_FIRST_OID_MAX;
+    arena->pgoff = vma->vm_pgoff;
+    arena->slot_pages = slot_pages;
+    arena->nr_slots = nr_pages / slot_pages;
+    kref_init(&arena->ref);
+    arena->mapping = vma->vm_file->f_mapping;
+    mutex_lock(&container->arena_lock);
+    list_add(&arena->a_node, &container->arenas);
+    mutex_unlock(&container->arena_lock);
+
+    vma->vm_ops = &memory_container_arena_vm_ops;
+    vma->vm_private_data = arena;
+    _set_vma_flags(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    return 0;
+}
+
+/**
+ * Maps an object, the lock page or an arena of caller's container
+ * The caller's reference on the container only lasts for the call,
+ * mappings rely on the references of the objects and arenas they map
+ */
+int _mmap_container(ContainerNode *container, struct vm_area_struct *vma)
+{
+    ObjectNode* existing_object;
+
+    // find out page offset of the current memory object 
+    __u64 offset = vma->vm_pgoff;
+    // calculate number of pages required
+    unsigned long nr_pages = vma_pages(vma);
+
+    if (offset == MCONTAINER_LOCK_PAGE_OID) {
+        return _mmap_lock_page(container, vma);
+    }
+    if (offset & MCONTAINER_ARENA_OID) {
+        return _mmap_arena(container, vma);
+    }
+
+    // try to find a memory object with same offset    
+    existing_object = (ObjectNode*)_get_memory_object(container, offset);
+
+    // create the object if it does not exist yet, it is backed lazily 
+    if (existing_object == NULL) {
+        existing_object = (ObjectNode*)_add_new_memory_object(container, offset, nr_pages);
+        if (IS_ERR(existing_object)) {
+            return PTR_ERR(existing_object);
+        }
+        this_cpu_inc(container->stats->mmap_allocs);
+        trace_mcontainer_mmap(container->id, offset, nr_pages << PAGE_SHIFT, 1);
     } else {
-        kmalloc_ptr = (char*)kmalloc(total_memory, GFP_KERNEL);
-        kmalloc_area = ((unsigned long)kmalloc_ptr) & PAGE_MASK;
-        // update list of memory object
-        _add_new_memory_object(offset, kmalloc_area);
+        this_cpu_inc(container->stats->mmap_hits);
+        trace_mcontainer_mmap(container->id, offset, nr_pages << PAGE_SHIFT, 0);
+    }
+
+    // an object cannot be mapped beyond the size it was created with
+    if (nr_pages > existing_object->nr_pages) {
+        _put_memory_object(existing_object);
+        return -EINVAL;
     }
-    
-    // get pfn for allocated area
-    pfn = virt_to_phys((void*)kmalloc_area) >> PAGE_SHIFT;
-    // map it
-    ret = remap_pfn_range(vma, vma->vm_start, pfn, total_memory, vma->vm_page_prot);
 
-    if (ret) return -EAGAIN;
-    if (ret < 0) return -EIO;
+    // pages are installed by memory_container_fault() on first touch
+    // the reference taken above belongs to the VMA now
+    vma->vm_ops = &memory_container_vm_ops;
+    vma->vm_private_data = existing_object;
+    _set_vma_flags(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    if (existing_object->huge && (vma->vm_flags & VM_SHARED)) {
+        // PMDs and PTEs are inserted by pfn, private mappings would need COW
+        // and keep using the split pages one by one
+        _set_vma_flags(vma, VM_PFNMAP | VM_HUGEPAGE);
+    }
     return 0;
 }
 
+int memory_container_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    ContainerNode* container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    int ret;
+
+    if (container == NULL) {
+        return -EINVAL;
+    }
+    ret = _mmap_container(container, vma);
+    _put_container(container);
+    return ret;
+}
+
 int memory_container_lock(struct memory_container_cmd __user *user_cmd)
 {
-    ContainerNode* container = (ContainerNode*)_find_container_containing_task(current->pid);
+    struct memory_container_cmd cmd;
+    ContainerNode* container;
+    int ret = 0;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container != NULL) {
+        ret = _lock_object(container, cmd.oid, 0, MAX_SCHEDULE_TIMEOUT);
+        _put_container(container);
+    }
+    return ret;
+}
+
+/**
+ * Locks an object shared with other readers, released by MCONTAINER_IOCTL_UNLOCK
+ */
+int memory_container_lock_shared(struct memory_container_cmd __user *user_cmd)
+{
+    struct memory_container_cmd cmd;
+    ContainerNode* container;
+    int ret = 0;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
     if (container != NULL) {
-        mutex_lock(&container->mem_lock);
+        ret = _lock_object(container, cmd.oid, 1, MAX_SCHEDULE_TIMEOUT);
+        _put_container(container);
+    }
+    return ret;
+}
+
+/**
+ * Locks an object only if that does not require waiting
+ * MCONTAINER_LOCK_SHARED in 'op' takes a shared lock
+ * @return 0 on success, -EBUSY if the lock is held or waited for,
+ *         -EINVAL if the caller is in no container
+ */
+int memory_container_trylock(struct memory_container_cmd __user *user_cmd)
+{
+    struct memory_container_cmd cmd;
+    ContainerNode* container;
+    int ret;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    if (cmd.op & ~MCONTAINER_LOCK_FLAGS) {
+        return -EINVAL;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container == NULL) {
+        return -EINVAL;
+    }
+    ret = _lock_object(container, cmd.oid, cmd.op & MCONTAINER_LOCK_SHARED, 0);
+    _put_container(container);
+    return ret;
+}
+
+/**
+ * Locks an object, waiting at most the given time
+ * The wait is interrupted by signals, it is not restarted since
+ * that would start the timeout over
+ * @return 0 on success, -ETIMEDOUT, -EINTR, or -EBUSY for a zero timeout,
+ *         -EINVAL if the caller is in no container
+ */
+int memory_container_timedlock(struct memory_container_timedlock __user *user_lock)
+{
+    struct memory_container_timedlock lock;
+    ContainerNode* container;
+    long timeout;
+    int ret;
+
+    if (copy_from_user(&lock, user_lock, sizeof(lock))) {
+        return -EFAULT;
+    }
+    if ((lock.flags & ~MCONTAINER_LOCK_FLAGS) || lock.reserved != 0) {
+        return -EINVAL;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container == NULL) {
+        return -EINVAL;
+    }
+
+    // a nonzero timeout waits at least a jiffy, MAX_SCHEDULE_TIMEOUT means forever
+    timeout = 0;
+    if (lock.timeout_ns != 0) {
+        timeout = clamp_t(u64, nsecs_to_jiffies64(lock.timeout_ns), 1, MAX_SCHEDULE_TIMEOUT - 1);
+    }
+    ret = _lock_object(container, lock.oid, lock.flags & MCONTAINER_LOCK_SHARED, timeout);
+    _put_container(container);
+    return ret;
+}
+
+/**
+ * Requests the lock of an object without blocking, MCONTAINER_LOCK_* flags in 'op'
+ * @return 0 if the lock is held now, -EINPROGRESS if the request was queued
+ */
+int memory_container_lock_async(struct file *filp, struct memory_container_cmd __user *user_cmd)
+{
+    struct memory_container_cmd cmd;
+    ContainerNode* container;
+    int ret;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    if (cmd.op & ~MCONTAINER_LOCK_FLAGS) {
+        return -EINVAL;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container == NULL) {
+        return -EINVAL;
+    }
+    ret = _lock_object_async((FileNode*)filp->private_data, container, cmd.oid, cmd.op & MCONTAINER_LOCK_SHARED);
+    _put_container(container);
+    return ret;
+}
+
+/**
+ * Hands the oids of granted asynchronous requests to user space
+ * Locks of entries that cannot be written back are released
+ * @return Number of oids written
+ */
+int memory_container_lock_collect(struct file *filp, struct memory_container_granted __user *user_granted)
+{
+    FileNode *file = (FileNode*)filp->private_data;
+    struct memory_container_granted granted;
+    LockRequest *requests[BATCH_CHUNK_SIZE];
+    __u64 oids[BATCH_CHUNK_SIZE];
+    __u64 __user *user_oids;
+    LockRequest *request, *next;
+    __u64 done = 0, chunk, i;
+    bool fault = false;
+
+    if (copy_from_user(&granted, user_granted, sizeof(granted))) {
+        return -EFAULT;
+    }
+    user_oids = (__u64 __user *)(unsigned long)granted.oids;
+
+    while (done < granted.count) {
+        chunk = 0;
+        spin_lock(&file->request_lock);
+        list_for_each_entry_safe(request, next, &file->requests, r_list) {
+            if (chunk == BATCH_CHUNK_SIZE || done + chunk == granted.count) {
+                break;
+            }
+            if (request->waiter.granted) {
+                list_del(&request->r_list);
+                file->nr_granted = file->nr_granted - 1;
+                requests[chunk] = request;
+                oids[chunk] = request->oid;
+                chunk++;
+            }
+        }
+        spin_unlock(&file->request_lock);
+        if (chunk == 0) {
+            break;
+        }
+
+        if (fault || copy_to_user(user_oids + done, oids, chunk * sizeof(oids[0]))) {
+            fault = true;
+        }
+        for (i = 0; i < chunk; i++) {
+            if (fault) {
+                _unlock_object(requests[i]->container, requests[i]->oid);
+            } else {
+                this_cpu_inc(requests[i]->container->stats->lock_acquisitions);
+            }
+            _put_container(requests[i]->container);
+            kfree(requests[i]);
+        }
+        if (!fault) {
+            done += chunk;
+        }
+    }
+    return fault ? -EFAULT : done;
+}
+
+/**
+ * Withdraws the oldest asynchronous request for the object in 'oid'
+ * A request that was granted but not collected yet releases its lock
+ * @return 0 on success, -ENOENT if there is no such request
+ */
+int memory_container_lock_cancel(struct file *filp, struct memory_container_cmd __user *user_cmd)
+{
+    FileNode *file = (FileNode*)filp->private_data;
+    struct memory_container_cmd cmd;
+    LockRequest *request, *found = NULL;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    spin_lock(&file->request_lock);
+    list_for_each_entry(request, &file->requests, r_list) {
+        if (request->oid == cmd.oid) {
+            list_del(&request->r_list);
+            found = request;
+            break;
+        }
+    }
+    spin_unlock(&file->request_lock);
+
+    if (found == NULL) {
+        return -ENOENT;
     }
+    _cancel_lock_request(file, found);
     return 0;
 }
 
 int memory_container_unlock(struct memory_container_cmd __user *user_cmd)
 {
-    ContainerNode* container = (ContainerNode*)_find_container_containing_task(current->pid);
+    struct memory_container_cmd cmd;
+    ContainerNode* container;
+    int ret = 0;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
     if (container != NULL) {
-        mutex_unlock(&container->mem_lock);
+        ret = _unlock_object(container, cmd.oid);
+        _put_container(container);
+    }
+    return ret;
+}
+
+/**
+ * Sleeps while the lock word of given object still holds the value in 'op'
+ * Slow path of the user space locks in the lock page
+ */
+int memory_container_lock_wait(struct memory_container_cmd __user *user_cmd)
+{
+    struct memory_container_cmd cmd;
+    ContainerNode *container;
+    __u32 *lock_word;
+    __u64 slot;
+    int ret;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container == NULL) {
+        return -EINVAL;
+    }
+    if (READ_ONCE(container->lock_page) == NULL) {
+        _put_container(container);
+        return -EINVAL;
+    }
+
+    slot = cmd.oid % MCONTAINER_LOCK_PAGE_SLOTS;
+    lock_word = (__u32*)page_address(container->lock_page) + slot;
+    ret = wait_event_killable(*_get_user_lock_wait_queue(container, slot), 
+            READ_ONCE(*lock_word) != (__u32)cmd.op);
+    _put_container(container);
+    return ret;
+}
+
+/**
+ * Wakes up tasks sleeping on the lock word of given object
+ */
+int memory_container_lock_wake(struct memory_container_cmd __user *user_cmd)
+{
+    struct memory_container_cmd cmd;
+    ContainerNode *container;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container == NULL) {
+        return -EINVAL;
     }
+
+    wake_up_all(_get_user_lock_wait_queue(container, cmd.oid % MCONTAINER_LOCK_PAGE_SLOTS));
+    _put_container(container);
     return 0;
 }
 
 int memory_container_delete(struct memory_container_cmd __user *user_cmd)
 {
-    _deregister_task_from_container(current->pid);
+    _deregister_task_from_container(current->tgid);
     
     return 0;
 }
 
+/**
+ * Creates given container if needed and moves calling task into it
+ * @param  cid           Container id
+ * @param  flags         MCONTAINER_CREATE_* flags
+ * @param  reserve_pages Size of the pool of a newly created container
+ * @return               0 on success, negative error code otherwise
+ */
+int _create_container_for_task(__u64 cid, __u64 flags, unsigned long reserve_pages) {
+    int ret;
+
+    if (flags & ~MCONTAINER_CREATE_FLAGS) {
+        return -EINVAL;
+    }
+
+    // a container torn down between the two steps is created anew
+    do {
+        ret = _register_container(cid, flags, reserve_pages);
+        if (ret) {
+            return ret;
+        }
+        ret = _register_task(cid, current);
+    } while (ret == -EAGAIN);
+    return ret;
+}
+
 int memory_container_create(struct memory_container_cmd __user *user_cmd)
 {
-    __u64 cid = _get_container_id_in_kernel(user_cmd);
-    
-    _register_container(cid);
+    struct memory_container_cmd cmd;
 
-    _register_task(cid, current);
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    // creation flags are carried in 'op'
+    return _create_container_for_task(cmd.cid, cmd.op, 0);
+}
 
-    return 0;
+/**
+ * Creates a container with a pool of memory reserved up front
+ * The whole pool is allocated before the call returns
+ * @return 0 on success, -ENOMEM if the pool could not be allocated
+ */
+int memory_container_create_reserved(struct memory_container_create __user *user_create)
+{
+    struct memory_container_create create;
+
+    if (copy_from_user(&create, user_create, sizeof(create))) {
+        return -EFAULT;
+    }
+    if (create.reserved != 0) {
+        return -EINVAL;
+    }
+    // more than the machine has can never be reserved
+    if (create.reserve_bytes > ((__u64)totalram_pages() << PAGE_SHIFT)) {
+        return -ENOMEM;
+    }
+    return _create_container_for_task(create.cid, create.flags, DIV_ROUND_UP(create.reserve_bytes, PAGE_SIZE));
 }
 
 int memory_container_free(struct memory_container_cmd __user *user_cmd)
 {
-    __u64 offset = _get_memory_object_offset_in_kernel(user_cmd);
+    struct memory_container_cmd cmd;
+    ContainerNode* container;
+
+    if (_get_cmd_in_kernel(&cmd, user_cmd)) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+    if (container != NULL) {
+        _remove_memory_object(container, cmd.oid);
+        _put_container(container);
+    }
+
+    return 0;
+}
+
+/**
+ * Sets the memory limit of the container given in 'cid'
+ * A limit below current usage only makes new allocations fail
+ */
+int memory_container_set_limit(struct memory_container_usage __user *user_usage)
+{
+    struct memory_container_usage usage;
+    ContainerNode *container;
+
+    if (copy_from_user(&usage, user_usage, sizeof(usage))) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_get_container(usage.cid);
+    if (container == NULL) {
+        return -ENOENT;
+    }
+    WRITE_ONCE(container->limit, usage.limit);
+    _put_container(container);
+    return 0;
+}
+
+/**
+ * Reports limit, current usage and peak usage of the container given in 'cid'
+ */
+int memory_container_get_usage(struct memory_container_usage __user *user_usage)
+{
+    struct memory_container_usage usage;
+    ContainerNode *container;
+
+    if (copy_from_user(&usage, user_usage, sizeof(usage))) {
+        return -EFAULT;
+    }
+    container = (ContainerNode*)_get_container(usage.cid);
+    if (container == NULL) {
+        return -ENOENT;
+    }
+    usage.limit = READ_ONCE(container->limit);
+    usage.usage = percpu_counter_sum_positive(&container->usage);
+    usage.peak = max_t(__u64, atomic64_read(&container->peak), usage.usage);
+    _put_container(container);
+    if (copy_to_user(user_usage, &usage, sizeof(usage))) {
+        return -EFAULT;
+    }
+    return 0;
+}
+
+/**
+ * Runs one entry of a batch
+ * Caller's container is resolved once per batch and only 
+ * looked up again after entries that change it
+ * @param  container Caller's container, updated by CREATE and DELETE,
+ *                   a reference is held on it while it is set
+ * @param  cmd       Entry copied from user space, 'op' is an ioctl number
+ * @return           Status of the entry
+ */
+long _run_batch_command(ContainerNode **container, struct memory_container_cmd *cmd) {
+    long ret;
+
+    switch (cmd->op)
+    {
+    case MCONTAINER_IOCTL_CREATE:
+        ret = _create_container_for_task(cmd->cid, 0, 0);
+        if (*container != NULL) {
+            _put_container(*container);
+        }
+        *container = (ContainerNode*)_find_container_containing_task(current->tgid);
+        return ret;
+    case MCONTAINER_IOCTL_DELETE:
+        _deregister_task_from_container(current->tgid);
+        if (*container != NULL) {
+            _put_container(*container);
+        }
+        *container = NULL;
+        return 0;
+    case MCONTAINER_IOCTL_LOCK:
+        return *container != NULL ? _lock_object(*container, cmd->oid, 0, MAX_SCHEDULE_TIMEOUT) : 0;
+    case MCONTAINER_IOCTL_LOCK_SHARED:
+        return *container != NULL ? _lock_object(*container, cmd->oid, 1, MAX_SCHEDULE_TIMEOUT) : 0;
+    case MCONTAINER_IOCTL_UNLOCK:
+        return *container != NULL ? _unlock_object(*container, cmd->oid) : 0;
+    case MCONTAINER_IOCTL_FREE:
+        if (*container != NULL) {
+            _remove_memory_object(*container, cmd->oid);
+        }
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
+/**
+ * Runs a vector of commands in a single call
+ * Entries are copied in chunks and run in order, the status of every
+ * entry is written back to user space, a failed entry does not stop 
+ * the ones after it
+ */
+int memory_container_batch(struct memory_container_batch __user *user_batch)
+{
+    struct memory_container_batch batch;
+    struct memory_container_cmd cmds[BATCH_CHUNK_SIZE];
+    __s64 statuses[BATCH_CHUNK_SIZE];
+    struct memory_container_cmd __user *user_cmds;
+    __s64 __user *user_statuses;
+    ContainerNode *container;
+    __u64 done, chunk, i;
+    int ret = 0;
+
+    if (copy_from_user(&batch, user_batch, sizeof(batch))) {
+        return -EFAULT;
+    }
+    if (batch.count > MCONTAINER_BATCH_MAX) {
+        return -E2BIG;
+    }
+    user_cmds = (struct memory_container_cmd __user *)(unsigned long)batch.cmds;
+    user_statuses = (__s64 __user *)(unsigned long)batch.statuses;
+
+    container = (ContainerNode*)_find_container_containing_task(current->tgid);
+
+    for (done = 0; done < batch.count; done += chunk) {
+        chunk = min_t(__u64, batch.count - done, BATCH_CHUNK_SIZE);
+        if (copy_from_user(cmds, user_cmds + done, chunk * sizeof(cmds[0]))) {
+            ret = -EFAULT;
+            break;
+        }
+        for (i = 0; i < chunk; i++) {
+            statuses[i] = _run_batch_command(&container, &cmds[i]);
+        }
+        if (copy_to_user(user_statuses + done, statuses, chunk * sizeof(statuses[0]))) {
+            ret = -EFAULT;
+            break;
+        }
+    }
+    if (container != NULL) {
+        _put_container(container);
+    }
+    return ret;
+}
+
+/**
+ * Sets up the state of a newly opened device file
+ */
+int memory_container_open(struct inode *inode, struct file *filp)
+{
+    FileNode *file = (FileNode*)kmalloc(sizeof(FileNode), GFP_KERNEL);
+
+    if (file == NULL) {
+        return -ENOMEM;
+    }
+    spin_lock_init(&file->request_lock);
+    INIT_LIST_HEAD(&file->requests);
+    file->nr_granted = 0;
+    init_waitqueue_head(&file->poll_wait);
+    filp->private_data = file;
+    return 0;
+}
+
+/**
+ * Withdraws all asynchronous requests of a closed file, 
+ * locks granted to them and not collected are released
+ */
+int memory_container_release(struct inode *inode, struct file *filp)
+{
+    FileNode *file = (FileNode*)filp->private_data;
+    LockRequest *request;
+
+    spin_lock(&file->request_lock);
+    while (!list_empty(&file->requests)) {
+        request = list_first_entry(&file->requests, LockRequest, r_list);
+        list_del(&request->r_list);
+        spin_unlock(&file->request_lock);
+        _cancel_lock_request(file, request);
+        spin_lock(&file->request_lock);
+    }
+    spin_unlock(&file->request_lock);
+    kfree(file);
+    return 0;
+}
 
-    _remove_memory_object(offset);
+/**
+ * Matches open files of the device while walking a file table
+ */
+int _is_device_file(const void *f_op, struct file *file, unsigned int fd) {
+    return file->f_op == f_op;
+}
 
+/**
+ * Takes the closing process out of its container, as if it called DELETE,
+ * once it holds no other file of the device
+ * Files are flushed whenever a file table drops them, on close(),
+ * close-on-exec and exit, the closed descriptor is gone from the table
+ * by then, the table of an exiting thread group is gone altogether
+ */
+int memory_container_flush(struct file *filp, fl_owner_t id)
+{
+    if (current->flags & PF_EXITING) {
+        _deregister_task_from_container(current->tgid);
+        return 0;
+    }
+    // a file table other than the caller's belongs to another process
+    if (id == current->files && !iterate_fd(current->files, 0, _is_device_file, filp->f_op)) {
+        _deregister_task_from_container(current->tgid);
+    }
     return 0;
 }
 
+/**
+ * Reports the file readable while it has granted requests to collect
+ */
+__poll_t memory_container_poll(struct file *filp, poll_table *wait)
+{
+    FileNode *file = (FileNode*)filp->private_data;
+
+    poll_wait(filp, &file->poll_wait, wait);
+    return READ_ONCE(file->nr_granted) > 0 ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
 /**
  * control function that receive the command in user space and pass arguments to
  * corresponding functions.
  */
-int memory_container_ioctl(struct file *filp, unsigned int cmd,
-                              unsigned long arg)
+long _run_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
     switch (cmd)
     {
@@ -472,7 +2987,119 @@ int memory_container_ioctl(struct file *filp, unsigned int cmd,
         return memory_container_unlock((void __user *)arg);
     case MCONTAINER_IOCTL_FREE:
         return memory_container_free((void __user *)arg);
+    case MCONTAINER_IOCTL_LOCK_WAIT:
+        return memory_container_lock_wait((void __user *)arg);
+    case MCONTAINER_IOCTL_LOCK_WAKE:
+        return memory_container_lock_wake((void __user *)arg);
+    case MCONTAINER_IOCTL_BATCH:
+        return memory_container_batch((void __user *)arg);
+    case MCONTAINER_IOCTL_SET_LIMIT:
+        return memory_container_set_limit((void __user *)arg);
+    case MCONTAINER_IOCTL_GET_USAGE:
+        return memory_container_get_usage((void __user *)arg);
+    case MCONTAINER_IOCTL_LOCK_SHARED:
+        return memory_container_lock_shared((void __user *)arg);
+    case MCONTAINER_IOCTL_TRYLOCK:
+        return memory_container_trylock((void __user *)arg);
+    case MCONTAINER_IOCTL_TIMEDLOCK:
+        return memory_container_timedlock((void __user *)arg);
+    case MCONTAINER_IOCTL_LOCK_ASYNC:
+        return memory_container_lock_async(filp, (void __user *)arg);
+    case MCONTAINER_IOCTL_LOCK_COLLECT:
+        return memory_container_lock_collect(filp, (void __user *)arg);
+    case MCONTAINER_IOCTL_LOCK_CANCEL:
+        return memory_container_lock_cancel(filp, (void __user *)arg);
+    case MCONTAINER_IOCTL_CREATE_RESERVED:
+        return memory_container_create_reserved((void __user *)arg);
     default:
         return -ENOTTY;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Returns the container id recorded in ioctl events
+ * That is the container named by SET_LIMIT and GET_USAGE, and the 
+ * caller's container for every other command
+ * @return Container id, TRACE_NO_CID if there is none
+ */
+__u64 _get_trace_cid(unsigned int cmd, unsigned long arg) {
+    struct memory_container_usage __user *user_usage = (void __user *)arg;
+    TaskNode *temp_task;
+    __u64 cid = TRACE_NO_CID;
+
+    if (cmd == MCONTAINER_IOCTL_SET_LIMIT || cmd == MCONTAINER_IOCTL_GET_USAGE) {
+        if (get_user(cid, &user_usage->cid)) {
+            return TRACE_NO_CID;
+        }
+        return cid;
+    }
+
+    // container nodes are freed after an RCU grace period like task nodes
+    rcu_read_lock();
+    temp_task = (TaskNode*)_get_task(current->tgid);
+    if (temp_task != NULL) {
+        cid = temp_task->container->id;
+    }
+    rcu_read_unlock();
+    return cid;
+}
+
+/**
+ * Returns the oid recorded in ioctl events
+ * Only commands that work on a single object carry one
+ * @return Oid, 0 for other commands or if it cannot be read
+ */
+__u64 _get_trace_oid(unsigned int cmd, unsigned long arg) {
+    struct memory_container_cmd __user *user_cmd = (void __user *)arg;
+    struct memory_container_timedlock __user *user_lock = (void __user *)arg;
+    __u64 oid = 0;
+
+    switch (cmd)
+    {
+    case MCONTAINER_IOCTL_LOCK:
+    case MCONTAINER_IOCTL_UNLOCK:
+    case MCONTAINER_IOCTL_FREE:
+    case MCONTAINER_IOCTL_LOCK_WAIT:
+    case MCONTAINER_IOCTL_LOCK_WAKE:
+    case MCONTAINER_IOCTL_LOCK_SHARED:
+    case MCONTAINER_IOCTL_TRYLOCK:
+    case MCONTAINER_IOCTL_LOCK_ASYNC:
+    case MCONTAINER_IOCTL_LOCK_CANCEL:
+        if (get_user(oid, &user_cmd->oid)) {
+            return 0;
+        }
+        return oid;
+    case MCONTAINER_IOCTL_TIMEDLOCK:
+        if (get_user(oid, &user_lock->oid)) {
+            return 0;
+        }
+        return oid;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * entry point of ioctls, wraps _run_ioctl() with tracepoints
+ * ids are only resolved while a tracepoint is enabled, the exit event
+ * resolves the container again, CREATE and DELETE change it
+ */
+int memory_container_ioctl(struct file *filp, unsigned int cmd,
+                              unsigned long arg)
+{
+    __u64 oid = 0;
+    long ret;
+
+    if (trace_mcontainer_ioctl_enter_enabled() || trace_mcontainer_ioctl_exit_enabled()) {
+        oid = _get_trace_oid(cmd, arg);
+    }
+
+    if (trace_mcontainer_ioctl_enter_enabled()) {
+        trace_mcontainer_ioctl_enter(cmd, _get_trace_cid(cmd, arg), oid, 0);
+    }
+    ret = _run_ioctl(filp, cmd, arg);
+    if (trace_mcontainer_ioctl_exit_enabled()) {
+        trace_mcontainer_ioctl_exit(cmd, _get_trace_cid(cmd, arg), oid, ret);
+    }
+    return ret;
+}
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Wrappers over kernel interfaces that changed between the
+//     supported kernels, 4.19 and later
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef MCONTAINER_COMPAT_H
+#define MCONTAINER_COMPAT_H
+
+#include <linux/version.h>
+#include <linux/mm.h>
+#include <linux/huge_mm.h>
+#include <linux/slab.h>
+#include <linux/shrinker.h>
+
+// PMDs mapping pfns of a VMA that is not DAX need vma_is_special_huge(),
+// older kernels map huge objects with single PTEs only
+#if defined(CONFIG_TRANSPARENT_HUGEPAGE) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+#define MCONTAINER_HUGE_FAULT
+#endif
+
+#ifdef MCONTAINER_HUGE_FAULT
+// huge_fault() is given the order of the fault instead of its size from 6.6 on
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+typedef unsigned int fault_size_t;
+#define FAULT_SIZE_PMD (PMD_SHIFT - PAGE_SHIFT)
+#else
+typedef enum page_entry_size fault_size_t;
+#define FAULT_SIZE_PMD PE_SIZE_PMD
+#endif
+
+// pfn_t is gone from vmf_insert_pfn_pmd() from 6.17 on
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 17, 0)
+#define page_to_pmd_pfn(page) page_to_pfn(page)
+#else
+#include <linux/pfn_t.h>
+#define page_to_pmd_pfn(page) page_to_pfn_t(page)
+#endif
+#endif
+
+/**
+ * Sets given flags on a VMA that is being mapped
+ * vm_flags can only be changed through vm_flags_set() from 6.3 on
+ */
+static inline void _set_vma_flags(struct vm_area_struct *vma, unsigned long flags) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_set(vma, flags);
+#else
+    vma->vm_flags |= flags;
+#endif
+}
+
+/**
+ * Creates and registers a shrinker with given callbacks
+ * Shrinkers are named from 6.0 on and allocated by the shrinker core from 6.7 on
+ * @return Shrinker, NULL if out of memory
+ */
+static inline struct shrinker* _create_shrinker(const char *name,
+        unsigned long (*count)(struct shrinker*, struct shrink_control*),
+        unsigned long (*scan)(struct shrinker*, struct shrink_control*)) {
+    struct shrinker *shrinker;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+    shrinker = shrinker_alloc(0, "%s", name);
+    if (shrinker == NULL) {
+        return NULL;
+    }
+    shrinker->count_objects = count;
+    shrinker->scan_objects = scan;
+    shrinker->seeks = DEFAULT_SEEKS;
+    shrinker_register(shrinker);
+#else
+    int ret;
+
+    shrinker = (struct shrinker*)kzalloc(sizeof(struct shrinker), GFP_KERNEL);
+    if (shrinker == NULL) {
+        return NULL;
+    }
+    shrinker->count_objects = count;
+    shrinker->scan_objects = scan;
+    shrinker->seeks = DEFAULT_SEEKS;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+    ret = register_shrinker(shrinker, "%s", name);
+#else
+    ret = register_shrinker(shrinker);
+#endif
+    if (ret) {
+        kfree(shrinker);
+        return NULL;
+    }
+#endif
+    return shrinker;
+}
+
+/**
+ * Unregisters and frees a shrinker made by _create_shrinker()
+ */
+static inline void _destroy_shrinker(struct shrinker *shrinker) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+    shrinker_free(shrinker);
+#else
+    unregister_shrinker(shrinker);
+    kfree(shrinker);
+#endif
+}
+
+#endif
@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////
+//                      North Carolina State University
+//
+//
+//
+//                             Copyright 2016
+//
+////////////////////////////////////////////////////////////////////////
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms and conditions of the GNU General Public License,
+// version 2, as published by the Free Software Foundation.
+//
+// This program is distributed in the hope it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+//
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Tracepoints of Memory Container, under events/mcontainer/
+//
+////////////////////////////////////////////////////////////////////////
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mcontainer
+
+#if !defined(MCONTAINER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define MCONTAINER_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/sched.h>
+
+// entry and exit of memory_container_ioctl()
+// cid is the caller's container as resolved by the module, or the one named
+// by SET_LIMIT and GET_USAGE, ~0 if there is none
+// oid is the object of commands on a single object, 0 for other commands
+DECLARE_EVENT_CLASS(mcontainer_ioctl_class,
+    TP_PROTO(unsigned int cmd, __u64 cid, __u64 oid, long ret),
+    TP_ARGS(cmd, cid, oid, ret),
+    TP_STRUCT__entry(
+        __field(unsigned int, cmd)
+        __field(__u64, cid)
+        __field(__u64, oid)
+        __field(pid_t, pid)
+        __field(long, ret)
+    ),
+    TP_fast_assign(
+        __entry->cmd = cmd;
+        __entry->cid = cid;
+        __entry->oid = oid;
+        __entry->pid = current->pid;
+        __entry->ret = ret;
+    ),
+    TP_printk("cmd=0x%x cid=%llu oid=%llu pid=%d ret=%ld",
+        __entry->cmd, __entry->cid, __entry->oid, __entry->pid, __entry->ret)
+);
+
+DEFINE_EVENT(mcontainer_ioctl_class, mcontainer_ioctl_enter,
+    TP_PROTO(unsigned int cmd, __u64 cid, __u64 oid, long ret),
+    TP_ARGS(cmd, cid, oid, ret)
+);
+
+DEFINE_EVENT(mcontainer_ioctl_class, mcontainer_ioctl_exit,
+    TP_PROTO(unsigned int cmd, __u64 cid, __u64 oid, long ret),
+    TP_ARGS(cmd, cid, oid, ret)
+);
+
+// mmap of an object, alloc is 1 if the call created the object
+TRACE_EVENT(mcontainer_mmap,
+    TP_PROTO(__u64 cid, __u64 oid, unsigned long size, int alloc),
+    TP_ARGS(cid, oid, size, alloc),
+    TP_STRUCT__entry(
+        __field(__u64, cid)
+        __field(__u64, oid)
+        __field(pid_t, pid)
+        __field(unsigned long, size)
+        __field(int, alloc)
+    ),
+    TP_fast_assign(
+        __entry->cid = cid;
+        __entry->oid = oid;
+        __entry->pid = current->pid;
+        __entry->size = size;
+        __entry->alloc = alloc;
+    ),
+    TP_printk("cid=%llu oid=%llu pid=%d size=%lu %s",
+        __entry->cid, __entry->oid, __entry->pid, __entry->size,
+        __entry->alloc ? "alloc" : "reuse")
+);
+
+// an object removed from its container
+TRACE_EVENT(mcontainer_free,
+    TP_PROTO(__u64 cid, __u64 oid, unsigned long size),
+    TP_ARGS(cid, oid, size),
+    TP_STRUCT__entry(
+        __field(__u64, cid)
+        __field(__u64, oid)
+        __field(pid_t, pid)
+        __field(unsigned long, size)
+    ),
+    TP_fast_assign(
+        __entry->cid = cid;
+        __entry->oid = oid;
+        __entry->pid = current->pid;
+        __entry->size = size;
+    ),
+    TP_printk("cid=%llu oid=%llu pid=%d size=%lu",
+        __entry->cid, __entry->oid, __entry->pid, __entry->size)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mcontainer_trace
+#include <trace/define_trace.h>
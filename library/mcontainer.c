@@ -31,6 +31,187 @@
 
 #include "mcontainer.h"
 
+#include <errno.h>
+#include <pthread.h>
+
+#define MAPPING_HASH_BITS 12
+
+// a mapping returned by mcontainer_alloc(), cached until unmapped or freed
+// every mcontainer_alloc() of the offset takes a reference, which
+// mcontainer_unmap() drops. Smaller mappings replaced by a larger one are
+// kept on 'retired' until the last reference is gone, callers may still use them
+struct mapping
+{
+    int devfd;
+    __u64 offset;
+    __u64 size;
+    void *addr;
+    __u64 refs;
+    struct mapping *retired;
+    struct mapping *next;
+};
+
+// lock pages mapped by this process, indexed by devfd
+static __u32 *lock_pages[MCONTAINER_MAX_DEVFDS];
+
+// mappings of this process, hashed by (devfd, offset)
+static struct mapping *mappings[1 << MAPPING_HASH_BITS];
+static pthread_rwlock_t mappings_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static struct mapping **_get_mapping_bucket(int devfd, __u64 offset)
+{
+    __u64 hash = (offset ^ ((__u64)devfd << 40)) * 0x9e3779b97f4a7c15ULL;
+    return &mappings[hash >> (64 - MAPPING_HASH_BITS)];
+}
+
+/**
+ * Finds the cached mapping of an object, the caller must hold mappings_lock.
+ * Returns the link pointing at the entry, or at NULL if there is none
+ */
+static struct mapping **_find_mapping(int devfd, __u64 offset)
+{
+    struct mapping **link = _get_mapping_bucket(devfd, offset);
+
+    while (*link != NULL && ((*link)->devfd != devfd || (*link)->offset != offset))
+    {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+/**
+ * Unmaps a mapping no longer in the cache along with the ones it retired.
+ */
+static void _unmap_mapping(struct mapping *mapping)
+{
+    struct mapping *retired;
+
+    while (mapping != NULL)
+    {
+        retired = mapping->retired;
+        munmap(mapping->addr, mapping->size);
+        free(mapping);
+        mapping = retired;
+    }
+}
+
+/**
+ * Drops a reference on the cached mapping of an object, or all of them if
+ * 'all' is set, and unmaps it once none is left.
+ * Returns 0 on success, -1 with ENOENT if the object is not mapped
+ */
+static int _remove_mapping(int devfd, __u64 offset, int all)
+{
+    struct mapping **link, *mapping;
+    int unmap = 0;
+
+    pthread_rwlock_wrlock(&mappings_lock);
+    link = _find_mapping(devfd, offset);
+    mapping = *link;
+    if (mapping != NULL)
+    {
+        mapping->refs = all || mapping->refs == 0 ? 0 : mapping->refs - 1;
+        if (mapping->refs == 0)
+        {
+            *link = mapping->next;
+            unmap = 1;
+        }
+    }
+    pthread_rwlock_unlock(&mappings_lock);
+
+    if (mapping == NULL)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    if (unmap)
+    {
+        _unmap_mapping(mapping);
+    }
+    return 0;
+}
+
+/**
+ * Unmaps all cached mappings of devfd, they belong to the old container.
+ */
+static void _drop_mappings(int devfd)
+{
+    struct mapping **link, *mapping;
+    size_t i;
+
+    pthread_rwlock_wrlock(&mappings_lock);
+    for (i = 0; i < sizeof(mappings) / sizeof(mappings[0]); i++)
+    {
+        link = &mappings[i];
+        while ((mapping = *link) != NULL)
+        {
+            if (mapping->devfd == devfd)
+            {
+                *link = mapping->next;
+                _unmap_mapping(mapping);
+            }
+            else
+            {
+                link = &mapping->next;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&mappings_lock);
+}
+
+/**
+ * Returns the lock word of given object in the lock page of the 
+ * caller's container, mapping the page on first use.
+ */
+static __u32 *_get_lock_word(int devfd, __u64 offset)
+{
+    __u32 *lock_page;
+    void *mapped_page;
+
+    if (devfd < 0 || devfd >= MCONTAINER_MAX_DEVFDS)
+    {
+        return NULL;
+    }
+
+    lock_page = __atomic_load_n(&lock_pages[devfd], __ATOMIC_ACQUIRE);
+    if (lock_page == NULL)
+    {
+        mapped_page = mmap(0, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, devfd, MCONTAINER_LOCK_PAGE_OID * getpagesize());
+        if (mapped_page == MAP_FAILED)
+        {
+            return NULL;
+        }
+        // another thread may have mapped it in the meantime
+        if (__atomic_compare_exchange_n(&lock_pages[devfd], &lock_page, (__u32 *)mapped_page, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            lock_page = (__u32 *)mapped_page;
+        }
+        else
+        {
+            munmap(mapped_page, getpagesize());
+        }
+    }
+    return lock_page + (offset % MCONTAINER_LOCK_PAGE_SLOTS);
+}
+
+/**
+ * Drops the lock page mapped for devfd, it belongs to the old container.
+ */
+static void _drop_lock_page(int devfd)
+{
+    __u32 *lock_page;
+
+    if (devfd < 0 || devfd >= MCONTAINER_MAX_DEVFDS)
+    {
+        return;
+    }
+    lock_page = __atomic_exchange_n(&lock_pages[devfd], NULL, __ATOMIC_ACQ_REL);
+    if (lock_page != NULL)
+    {
+        munmap(lock_page, getpagesize());
+    }
+}
+
 /**
  * delete function in user space that sends command to kernel space
  * for deleting the current task in specified container.
@@ -38,6 +219,7 @@
 int mcontainer_delete(int devfd)
 {
     struct memory_container_cmd cmd;
+    _drop_mappings(devfd);
     return ioctl(devfd, MCONTAINER_IOCTL_DELETE, &cmd);
 }
 
@@ -46,23 +228,193 @@ int mcontainer_delete(int devfd)
  * for creating the current task in specified container.
  */
 int mcontainer_create(int devfd, int cid)
+{
+    return mcontainer_create_with_flags(devfd, cid, 0);
+}
+
+/**
+ * create function with MCONTAINER_CREATE_* flags, flags only take
+ * effect if this call creates the container. Objects mapped through
+ * devfd are unmapped, their offsets refer to the old container.
+ */
+int mcontainer_create_with_flags(int devfd, int cid, __u64 flags)
 {
     struct memory_container_cmd cmd;
+    cmd.op = flags;
     cmd.cid = cid;
+    _drop_lock_page(devfd);
+    _drop_mappings(devfd);
     return ioctl(devfd, MCONTAINER_IOCTL_CREATE, &cmd);
 }
 
+/**
+ * create function that reserves reserve_bytes of memory for the container's
+ * objects when this call creates it. Objects only use that memory, creating
+ * one fails with ENOMEM once the rest of the reservation cannot back it.
+ * MCONTAINER_CREATE_NUMA_LOCAL takes the memory from the caller's node.
+ */
+int mcontainer_create_reserved(int devfd, int cid, __u64 flags, __u64 reserve_bytes)
+{
+    struct memory_container_create create;
+    create.cid = cid;
+    create.flags = flags;
+    create.reserve_bytes = reserve_bytes;
+    create.reserved = 0;
+    _drop_lock_page(devfd);
+    _drop_mappings(devfd);
+    return ioctl(devfd, MCONTAINER_IOCTL_CREATE_RESERVED, &create);
+}
+
+/**
+ * create function that also sets a memory limit in bytes on the container,
+ * objects that would take the container over the limit fail with ENOMEM.
+ * When the container exists already the caller joins it and its limit is
+ * replaced by the given one, like mcontainer_set_limit() would do.
+ */
+int mcontainer_create_with_limit(int devfd, int cid, __u64 flags, __u64 limit)
+{
+    int ret = mcontainer_create_with_flags(devfd, cid, flags);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    return mcontainer_set_limit(devfd, cid, limit);
+}
+
+/**
+ * Sets the memory limit of a container in bytes, 0 removes the limit.
+ */
+int mcontainer_set_limit(int devfd, int cid, __u64 limit)
+{
+    struct memory_container_usage usage;
+    usage.cid = cid;
+    usage.limit = limit;
+    return ioctl(devfd, MCONTAINER_IOCTL_SET_LIMIT, &usage);
+}
+
+/**
+ * Reads limit, current usage and peak usage of a container in bytes.
+ */
+int mcontainer_get_usage(int devfd, int cid, struct memory_container_usage *usage)
+{
+    usage->cid = cid;
+    return ioctl(devfd, MCONTAINER_IOCTL_GET_USAGE, usage);
+}
+
 /**
  * Allocate memory in kernel space for sharing along with tasks in the same container.
+ * Mappings are cached per (devfd, offset) and shared by all threads, so mapping an
+ * object again returns the same address without a syscall as long as 'size' fits.
+ * A larger size maps the object anew, the smaller mapping stays valid until it is
+ * released. Every call takes a reference that mcontainer_unmap() drops, the object
+ * is unmapped once no caller holds one. Use mcontainer_unmap() rather than munmap()
+ * on the result.
+ * The cache only knows about this process: after another process frees the object,
+ * the cached mapping still refers to the old object until it is released here.
+ * Untouched pages of a freed object fault with SIGBUS.
  */
 void *mcontainer_alloc(int devfd, __u64 offset, __u64 size)
 {
     __u64 aligned_size = ((size + getpagesize() - 1) / getpagesize()) * getpagesize();
-    return mmap(0, aligned_size, PROT_READ | PROT_WRITE, MAP_SHARED, devfd, offset * getpagesize());
+    struct mapping *mapping, *old;
+    struct mapping **link;
+    void *addr = MAP_FAILED;
+
+    pthread_rwlock_rdlock(&mappings_lock);
+    mapping = *_find_mapping(devfd, offset);
+    if (mapping != NULL && mapping->size >= aligned_size)
+    {
+        // readers only ever add references, dropping one takes the lock exclusively
+        __atomic_add_fetch(&mapping->refs, 1, __ATOMIC_RELAXED);
+        addr = mapping->addr;
+    }
+    pthread_rwlock_unlock(&mappings_lock);
+    if (addr != MAP_FAILED)
+    {
+        return addr;
+    }
+
+    addr = mmap(0, aligned_size, PROT_READ | PROT_WRITE, MAP_SHARED, devfd, offset * getpagesize());
+    if (addr == MAP_FAILED)
+    {
+        return addr;
+    }
+    mapping = (struct mapping *)malloc(sizeof(struct mapping));
+    if (mapping == NULL)
+    {
+        // still usable, just not cached
+        return addr;
+    }
+    mapping->devfd = devfd;
+    mapping->offset = offset;
+    mapping->size = aligned_size;
+    mapping->addr = addr;
+    mapping->refs = 1;
+    mapping->retired = NULL;
+
+    pthread_rwlock_wrlock(&mappings_lock);
+    link = _find_mapping(devfd, offset);
+    old = *link;
+    if (old != NULL && old->size >= aligned_size)
+    {
+        // another thread mapped it in the meantime
+        old->refs++;
+        addr = old->addr;
+        pthread_rwlock_unlock(&mappings_lock);
+        munmap(mapping->addr, aligned_size);
+        free(mapping);
+        return addr;
+    }
+    if (old != NULL)
+    {
+        // holders of the smaller mapping keep using it, it goes with the new one
+        mapping->refs += old->refs;
+        mapping->retired = old;
+        mapping->next = old->next;
+    }
+    else
+    {
+        mapping->next = NULL;
+    }
+    *link = mapping;
+    pthread_rwlock_unlock(&mappings_lock);
+    return addr;
+}
+
+/**
+ * Maps 'count' objects starting at 'first_oid' with a single mapping. Object
+ * first_oid + i is at i * slot_size bytes, rounded up to pages, and is created
+ * with that size when the slot is first touched. Slots of objects that already
+ * exist with a smaller size fault with SIGBUS past the object's end. A freed
+ * object leaves its slot, which starts over as a new object when touched.
+ * Release the arena with munmap(addr, count * slot size).
+ */
+void *mcontainer_map_range(int devfd, __u64 first_oid, __u64 count, __u64 slot_size)
+{
+    __u64 slot_pages = (slot_size + getpagesize() - 1) / getpagesize();
+
+    if (count == 0 || slot_pages == 0 || slot_pages > MCONTAINER_ARENA_SLOT_MAX ||
+        first_oid > MCONTAINER_ARENA_FIRST_OID_MAX)
+    {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    return mmap(0, count * slot_pages * getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, devfd,
+                MCONTAINER_ARENA_OFFSET(first_oid, slot_pages) * getpagesize());
 }
 
 /**
- * Lock a memory page
+ * Releases a reference taken by mcontainer_alloc(), the object is unmapped
+ * when no thread holds one anymore. The object itself is kept.
+ */
+int mcontainer_unmap(int devfd, __u64 offset)
+{
+    return _remove_mapping(devfd, offset, 0);
+}
+
+/**
+ * Lock a memory object, tasks locking other objects are not blocked
+ * unless the container was created with MCONTAINER_CREATE_CONTAINER_LOCK
  */
 int mcontainer_lock(int devfd, __u64 offset)
 {
@@ -72,7 +424,86 @@ int mcontainer_lock(int devfd, __u64 offset)
 }
 
 /**
- * Unlock a memory page
+ * Lock a memory object shared with other readers. Writers holding or waiting
+ * for the lock go first, readers and writers are served in arrival order.
+ * Released by mcontainer_unlock()
+ */
+int mcontainer_lock_shared(int devfd, __u64 offset)
+{
+    struct memory_container_cmd cmd;
+    cmd.oid = offset;
+    return ioctl(devfd, MCONTAINER_IOCTL_LOCK_SHARED, &cmd);
+}
+
+/**
+ * Lock a memory object if that does not require waiting, with MCONTAINER_LOCK_*
+ * flags. Returns -1 with errno EBUSY if the lock is held or others wait for it,
+ * EINVAL if the task is in no container
+ */
+int mcontainer_trylock(int devfd, __u64 offset, __u64 flags)
+{
+    struct memory_container_cmd cmd;
+    cmd.op = flags;
+    cmd.oid = offset;
+    return ioctl(devfd, MCONTAINER_IOCTL_TRYLOCK, &cmd);
+}
+
+/**
+ * Lock a memory object, waiting at most timeout_ns nanoseconds, with
+ * MCONTAINER_LOCK_* flags. Returns -1 with errno ETIMEDOUT when the time
+ * runs out, EINTR when a signal arrives first, EINVAL if the task is in no
+ * container.
+ */
+int mcontainer_lock_timed(int devfd, __u64 offset, __u64 flags, __u64 timeout_ns)
+{
+    struct memory_container_timedlock lock;
+    lock.oid = offset;
+    lock.flags = flags;
+    lock.timeout_ns = timeout_ns;
+    lock.reserved = 0;
+    return ioctl(devfd, MCONTAINER_IOCTL_TIMEDLOCK, &lock);
+}
+
+/**
+ * Request the lock of a memory object without blocking, with
+ * MCONTAINER_LOCK_* flags. Returns 0 when the lock was free, -1 with errno
+ * EINPROGRESS when the request was queued. devfd polls readable once queued
+ * requests are granted, mcontainer_lock_collect() then picks them up.
+ * Requests belong to the open file, so forked children share them.
+ */
+int mcontainer_lock_async(int devfd, __u64 offset, __u64 flags)
+{
+    struct memory_container_cmd cmd;
+    cmd.op = flags;
+    cmd.oid = offset;
+    return ioctl(devfd, MCONTAINER_IOCTL_LOCK_ASYNC, &cmd);
+}
+
+/**
+ * Store up to count offsets of granted lock requests, whose locks are now
+ * held. Returns the number stored, 0 if nothing was granted yet.
+ */
+int mcontainer_lock_collect(int devfd, __u64 *offsets, __u64 count)
+{
+    struct memory_container_granted granted;
+    granted.count = count;
+    granted.oids = (__u64)(unsigned long)offsets;
+    return ioctl(devfd, MCONTAINER_IOCTL_LOCK_COLLECT, &granted);
+}
+
+/**
+ * Withdraw a lock request, releasing the lock if it was granted and
+ * not collected yet. Returns -1 with errno ENOENT if there is none.
+ */
+int mcontainer_lock_cancel(int devfd, __u64 offset)
+{
+    struct memory_container_cmd cmd;
+    cmd.oid = offset;
+    return ioctl(devfd, MCONTAINER_IOCTL_LOCK_CANCEL, &cmd);
+}
+
+/**
+ * Unlock a memory page, locked either by mcontainer_lock() or mcontainer_lock_shared()
  */
 int mcontainer_unlock(int devfd, __u64 offset)
 {
@@ -82,11 +513,107 @@ int mcontainer_unlock(int devfd, __u64 offset)
 }
 
 /**
- * removes an object from memory_container
+ * Lock a memory object through the container's lock page. Uncontended
+ * locks never enter the kernel, waiters sleep in MCONTAINER_IOCTL_LOCK_WAIT.
+ * These locks are separate from the ones taken by mcontainer_lock(), so all
+ * tasks of a container should use the same kind. Objects whose offsets are
+ * equal modulo MCONTAINER_LOCK_PAGE_SLOTS share a lock word.
+ * Falls back to mcontainer_lock() if the lock page cannot be mapped.
+ */
+int mcontainer_lock_fast(int devfd, __u64 offset)
+{
+    struct memory_container_cmd cmd;
+    __u32 *lock_word = _get_lock_word(devfd, offset);
+    __u32 state = 0;
+
+    if (lock_word == NULL)
+    {
+        return mcontainer_lock(devfd, offset);
+    }
+
+    // 0: unlocked, 1: locked, 2: locked and may have waiters
+    if (__atomic_compare_exchange_n(lock_word, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return 0;
+    }
+
+    if (state != 2)
+    {
+        state = __atomic_exchange_n(lock_word, 2, __ATOMIC_ACQUIRE);
+    }
+    cmd.op = 2;
+    cmd.oid = offset;
+    while (state != 0)
+    {
+        if (ioctl(devfd, MCONTAINER_IOCTL_LOCK_WAIT, &cmd) < 0 && errno != EINTR)
+        {
+            return -1;
+        }
+        state = __atomic_exchange_n(lock_word, 2, __ATOMIC_ACQUIRE);
+    }
+    return 0;
+}
+
+/**
+ * Unlock a memory object locked by mcontainer_lock_fast()
+ */
+int mcontainer_unlock_fast(int devfd, __u64 offset)
+{
+    struct memory_container_cmd cmd;
+    __u32 *lock_word = _get_lock_word(devfd, offset);
+
+    if (lock_word == NULL)
+    {
+        return mcontainer_unlock(devfd, offset);
+    }
+
+    if (__atomic_fetch_sub(lock_word, 1, __ATOMIC_RELEASE) != 1)
+    {
+        // there may be waiters, release fully and wake them up
+        __atomic_store_n(lock_word, 0, __ATOMIC_RELEASE);
+        cmd.oid = offset;
+        return ioctl(devfd, MCONTAINER_IOCTL_LOCK_WAKE, &cmd);
+    }
+    return 0;
+}
+
+/**
+ * Runs 'count' commands in one call. 'op' of each command is the ioctl
+ * number of the operation, e.g. MCONTAINER_IOCTL_LOCK. The status of
+ * every command is stored in 'statuses', one failed command does not
+ * stop the following ones. Cached mappings are dropped up front as the
+ * single command functions do.
+ */
+int mcontainer_batch(int devfd, struct memory_container_cmd *cmds, __s64 *statuses, __u64 count)
+{
+    struct memory_container_batch batch;
+    __u64 i;
+    for (i = 0; i < count; i++)
+    {
+        if (cmds[i].op == MCONTAINER_IOCTL_CREATE || cmds[i].op == MCONTAINER_IOCTL_DELETE)
+        {
+            _drop_lock_page(devfd);
+            _drop_mappings(devfd);
+        }
+        else if (cmds[i].op == MCONTAINER_IOCTL_FREE)
+        {
+            _remove_mapping(devfd, cmds[i].oid, 1);
+        }
+    }
+    batch.count = count;
+    batch.cmds = (__u64)(unsigned long)cmds;
+    batch.statuses = (__u64)(unsigned long)statuses;
+    return ioctl(devfd, MCONTAINER_IOCTL_BATCH, &batch);
+}
+
+/**
+ * removes an object from memory_container, unmapping it first. The mapping
+ * goes away for all threads of the process, whatever references they hold
  */
 int mcontainer_free(int devfd, __u64 offset)
 {
     struct memory_container_cmd cmd;
+    _remove_mapping(devfd, offset, 1);
     cmd.oid = offset;
     return ioctl(devfd, MCONTAINER_IOCTL_FREE, &cmd);
 }
\ No newline at end of file
@@ -42,12 +42,31 @@ extern "C"
 #include <stdio.h>
 #include <stdlib.h>
 
+// highest devfd + 1 for which lock pages are cached by the library
+#define MCONTAINER_MAX_DEVFDS 1024
+
     int mcontainer_delete(int devfd);
     int mcontainer_create(int devfd, int cid);
+    int mcontainer_create_with_flags(int devfd, int cid, __u64 flags);
+    int mcontainer_create_with_limit(int devfd, int cid, __u64 flags, __u64 limit);
+    int mcontainer_create_reserved(int devfd, int cid, __u64 flags, __u64 reserve_bytes);
+    int mcontainer_set_limit(int devfd, int cid, __u64 limit);
+    int mcontainer_get_usage(int devfd, int cid, struct memory_container_usage *usage);
     void *mcontainer_alloc(int devfd, __u64 offset, __u64 size);
+    int mcontainer_unmap(int devfd, __u64 offset);
+    void *mcontainer_map_range(int devfd, __u64 first_oid, __u64 count, __u64 slot_size);
     int mcontainer_lock(int devfd, __u64 offset);
+    int mcontainer_lock_shared(int devfd, __u64 offset);
+    int mcontainer_trylock(int devfd, __u64 offset, __u64 flags);
+    int mcontainer_lock_timed(int devfd, __u64 offset, __u64 flags, __u64 timeout_ns);
+    int mcontainer_lock_async(int devfd, __u64 offset, __u64 flags);
+    int mcontainer_lock_collect(int devfd, __u64 *offsets, __u64 count);
+    int mcontainer_lock_cancel(int devfd, __u64 offset);
     int mcontainer_unlock(int devfd, __u64 offset);
+    int mcontainer_lock_fast(int devfd, __u64 offset);
+    int mcontainer_unlock_fast(int devfd, __u64 offset);
     int mcontainer_free(int devfd, __u64 offset);
+    int mcontainer_batch(int devfd, struct memory_container_cmd *cmds, __s64 *statuses, __u64 count);
 
 #ifdef __cplusplus
 }
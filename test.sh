@@ -0,0 +1,36 @@
+#!/bin/bash
+#
+# Runs the original benchmark workload and validates the container contents
+#
+#   ./test.sh <num of objects> <max size of objects> <num of tasks> <num of containers>
+#
+# The module must be loaded and /dev/mcontainer writable. Containers
+# are kept between benchmark and validate through the container_grace_ms
+# parameter, which needs root. For the performance matrix over the same
+# axes see benchmark/sweep.sh.
+
+if [ $# -ne 4 ]; then
+    echo "Usage: $0 <num of objects> <max size of objects> <num of tasks> <num of containers>" >&2
+    exit 1
+fi
+
+cd "$(dirname "$0")/benchmark" || exit 1
+
+# containers are torn down once their last task leaves, keep them until
+# validate has checked them, restoring the old value tears them down
+grace=/sys/module/memory_container/parameters/container_grace_ms
+if ! old_grace=$(cat "$grace") || ! echo -1 > "$grace"; then
+    echo "$0: cannot keep containers through $grace" >&2
+    exit 1
+fi
+trap 'echo "$old_grace" > "$grace"' EXIT
+
+rm -f mcontainer.*.log
+./benchmark "$1" "$2" "$3" "$4" || exit 1
+
+# validate merges the logs of all tasks in time order
+./validate "$1" "$2" "$4" mcontainer.*.log
+status=$?
+
+rm -f mcontainer.*.log
+exit $status